@@ -30,12 +30,72 @@
  * The FPGA has an AXI4 slave port that is connected to the PS GP port
  * as a slave. In this simulation, it is connected to the axi4_slave_slot
  * so that the C coded simulation can drive it.
+ *
+ * USER INPUTS
+ * The push buttons and DIP switches are driven by the button_stim
+ * generator, which is quiet unless enabled with the +stim-enable
+ * plusarg. The master can also take over the inputs by writing the
+ * SIM_UserInForce address. The button_check module watches the
+ * debounced inputs inside the device, and reports spurious or missed
+ * changes.
  */
 module SLF_SIM;
 
    localparam REGS_ADDR_WIDTH = 24;
 
-   initial $dumpvars;
+   // The fast mode scales the slow timers in the device down to a few
+   // clocks, so that tests of the inputs and LEDs run quickly.
+`ifdef SLF_SIM_FAST
+   localparam DEBOUNCE_FILTER = 16;
+   localparam PWM_CLOCK_DIVIDER = 4;
+`else
+   localparam DEBOUNCE_FILTER = 100000;
+   localparam PWM_CLOCK_DIVIDER = 3125;
+`endif
+
+   // Waveform dumping is off unless asked for. These plusargs turn it
+   // on:
+   //
+   //   +dump               Dump the whole simulation
+   //   +dump-start=<time>  Start dumping at this time (ps)
+   //   +dump-stop=<time>   Stop dumping at this time (ps)
+   //
+   // The master can also turn dumping on and off by writing 1 or 0 to
+   // the SIM_DumpCtl address, which the device itself ignores. That
+   // allows a test to dump only the part that it is interested in.
+   localparam [REGS_ADDR_WIDTH-1:0] SIM_DumpCtl = 'hff_fff0;
+
+   reg        dump_started = 1'b0;
+   task dump_on;
+      if (! dump_started) begin
+	 $dumpvars;
+	 dump_started = 1'b1;
+      end else begin
+	 $dumpon;
+      end
+   endtask
+
+   task dump_off;
+      if (dump_started)
+	$dumpoff;
+   endtask
+
+   reg [63:0] dump_start;
+   reg [63:0] dump_stop;
+   initial begin
+      if ($test$plusargs("dump-start=") || $test$plusargs("dump-stop=")) begin
+	 if (! $value$plusargs("dump-start=%d", dump_start))
+	   dump_start = 0;
+	 if ($value$plusargs("dump-stop=%d", dump_stop)) begin
+	    #(dump_start) dump_on;
+	    #(dump_stop - dump_start) dump_off;
+	 end else begin
+	    #(dump_start) dump_on;
+	 end
+      end else if ($test$plusargs("dump")) begin
+	 dump_on;
+      end
+   end
 
    wire global_aclk;
    wire global_areset_n;
@@ -101,10 +161,68 @@ module SLF_SIM;
       .IRQ    (regs_irq)
       /* */);
 
+   wire [7:0] 		      user_in_stim_out;
+   button_stim #(.WIDTH(8), .HOLD_MAX(2*DEBOUNCE_FILTER),
+		 .BOUNCE_WIDTH_MAX(DEBOUNCE_FILTER/16)) user_in_stim
+     (.CLOCK(global_aclk),
+      .OUT  (user_in_stim_out)
+      /* */);
+
+   // The master can force the inputs to a value by writing it to the
+   // SIM_UserInForce address with bit 31 set, and give them back to
+   // the button_stim by writing bit 31 clear. The device ignores the
+   // address. The forced value reaches the inputs on the clock after
+   // the write, so a test can place edges precisely. A delay in bits
+   // [23:16] holds the value off for that many more clocks, so that a
+   // test can also place an edge after a later write, for example on
+   // the same clock as the write that clears its flag.
+   localparam [REGS_ADDR_WIDTH-1:0] SIM_UserInForce = 'hff_fff4;
+
+   reg 			      user_in_force_enable = 1'b0;
+   reg [7:0] 		      user_in_force_value = 8'h00;
+   reg [7:0] 		      user_in_force_delay = 8'h00;
+   reg 			      user_in_force_next_enable;
+   reg [7:0] 		      user_in_force_next_value;
+   always @(posedge global_aclk)
+     if (slf_fpga.write_enable && slf_fpga.write_address == SIM_UserInForce) begin
+	if (slf_fpga.write_data[23:16] == 8'h00) begin
+	   user_in_force_enable <= slf_fpga.write_data[31];
+	   user_in_force_value  <= slf_fpga.write_data[7:0];
+	end
+	user_in_force_next_enable <= slf_fpga.write_data[31];
+	user_in_force_next_value  <= slf_fpga.write_data[7:0];
+	user_in_force_delay <= slf_fpga.write_data[23:16];
+
+     end else if (user_in_force_delay != 8'h00) begin
+	if (user_in_force_delay == 8'h01) begin
+	   user_in_force_enable <= user_in_force_next_enable;
+	   user_in_force_value  <= user_in_force_next_value;
+	end
+	user_in_force_delay <= user_in_force_delay - 1;
+     end
+
+   wire [7:0] 		      user_in_raw = user_in_force_enable? user_in_force_value : user_in_stim_out;
+
+   // The debounce engine counts the filter in ticks, so a change may
+   // take up to two ticks more than the filter time to come through.
+   // The filter and the Fast inputs can be changed at run time, so
+   // the checker follows the DebounceControl register.
+   localparam DEBOUNCE_TICK = DEBOUNCE_FILTER >= 64? DEBOUNCE_FILTER / 64 : 1;
+   button_check #(.WIDTH(8), .SLACK(2*DEBOUNCE_TICK + 4)) user_in_check
+     (.CLOCK    (global_aclk),
+      .RESET    (~global_areset_n),
+      .FILTER   (slf_fpga.DebounceControl_filter * DEBOUNCE_TICK),
+      .FAST     (slf_fpga.DebounceControl_fast),
+      .RAW      (user_in_raw),
+      .DEBOUNCED(slf_fpga.UserIn_register[7:0])
+      /* */);
+
    wire [7:0] 		      LED;
-   wire [3:0] 		      push_button = 4'b0000;
-   wire [3:0] 		      dip_switch = 4'b0000;
-   SLF_FPGA #(.addr_width(REGS_ADDR_WIDTH)) slf_fpga
+   wire [3:0] 		      push_button = user_in_raw[3:0];
+   wire [3:0] 		      dip_switch = user_in_raw[7:4];
+   SLF_FPGA #(.addr_width(REGS_ADDR_WIDTH),
+	      .DEBOUNCE_FILTER(DEBOUNCE_FILTER),
+	      .PWM_CLOCK_DIVIDER(PWM_CLOCK_DIVIDER)) slf_fpga
      (// Global signals
       .AXI_S_ACLK   (global_aclk),
       .AXI_ARESETn  (global_areset_n),
@@ -153,4 +271,13 @@ module SLF_SIM;
       .DIP_SW3(dip_switch[3])
       /* */);
 
+   // Watch for writes to the dump control address.
+   always @(posedge global_aclk)
+     if (slf_fpga.write_enable && slf_fpga.write_address == SIM_DumpCtl) begin
+	if (slf_fpga.write_data[0])
+	  dump_on;
+	else
+	  dump_off;
+     end
+
 endmodule // SLF_SIM
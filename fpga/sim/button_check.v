@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+`default_nettype none
+`timescale 1ps/1ps
+
+/*
+ * This checks the debounced inputs against the raw inputs. The filter
+ * should pass a raw value that is stable for FILTER clocks, and should
+ * pass nothing else. An input with its FAST bit set should instead
+ * pass the first raw edge within SLACK clocks, and then hold the new
+ * value for at least FILTER clocks. The FILTER and FAST inputs follow
+ * the device settings, which may change at run time. The checker
+ * counts:
+ *
+ *   events   - Debounced changes to a raw value that was stable for
+ *              at least FILTER clocks. The latency is the time from
+ *              the last raw edge to the debounced change.
+ *   fast     - Debounced changes of FAST inputs to a value that the
+ *              raw input had within the last SLACK clocks. The latency
+ *              is the time from the last raw edge, and is reported
+ *              separately, since it should only be a few clocks.
+ *   spurious - Debounced changes to a value that the raw input did not
+ *              hold for FILTER clocks, or FAST changes that come too
+ *              late or too soon after the previous change.
+ *   missed   - Raw values that were stable for more than FILTER+SLACK
+ *              clocks without the debounced input following.
+ *
+ * Each spurious or missed event is reported as it happens. A summary
+ * is printed every +stim-report=<N> clocks, if that plusarg is given.
+ */
+module button_check
+  #(parameter WIDTH = 8,
+    parameter SLACK = 4
+    /* */)
+   (input wire CLOCK,
+    input wire RESET,
+    // The filter time in clocks, and the inputs in fast mode.
+    input wire [31:0] FILTER,
+    input wire [WIDTH-1:0] FAST,
+    input wire [WIDTH-1:0] RAW,
+    input wire [WIDTH-1:0] DEBOUNCED
+    /* */);
+
+   integer events;
+   integer spurious;
+   integer missed;
+   integer latency_min;
+   integer latency_max;
+   real    latency_sum;
+   integer fast;
+   integer fast_latency_min;
+   integer fast_latency_max;
+   real    fast_latency_sum;
+   integer report_interval;
+
+   initial begin
+      events = 0;
+      spurious = 0;
+      missed = 0;
+      latency_min = 0;
+      latency_max = 0;
+      latency_sum = 0.0;
+      fast = 0;
+      fast_latency_min = 0;
+      fast_latency_max = 0;
+      fast_latency_sum = 0.0;
+      if (! $value$plusargs("stim-report=%d", report_interval))
+	report_interval = 0;
+   end
+
+   task report;
+      begin
+	 $display("button_check: %0t: events=%0d spurious=%0d missed=%0d latency min/avg/max=%0d/%0.1f/%0d clocks",
+		  $time, events, spurious, missed, latency_min,
+		  events? latency_sum / events : 0.0, latency_max);
+	 $display("button_check: %0t: fast=%0d latency min/avg/max=%0d/%0.1f/%0d clocks",
+		  $time, fast, fast_latency_min,
+		  fast? fast_latency_sum / fast : 0.0, fast_latency_max);
+      end
+   endtask
+
+   integer report_count;
+   always @(posedge CLOCK)
+     if (RESET || report_interval == 0) begin
+	report_count = 0;
+     end else begin
+	report_count = report_count + 1;
+	if (report_count >= report_interval) begin
+	   report;
+	   report_count = 0;
+	end
+     end
+
+   genvar idx;
+   generate for (idx = 0 ; idx < WIDTH ; idx = idx + 1) begin : input_check
+      reg     raw_prev;
+      reg     deb_prev;
+      reg     missed_flag;
+      integer stable;
+      // Clocks since the raw input was last 0 and last 1.
+      integer age0;
+      integer age1;
+      // Clocks since the last debounced change, and whether that
+      // change was a fast one that locks out the next.
+      integer held;
+      reg     held_fast;
+
+      always @(posedge CLOCK)
+	if (RESET) begin
+	   raw_prev = RAW[idx];
+	   deb_prev = DEBOUNCED[idx];
+	   missed_flag = 0;
+	   stable = 0;
+	   age0 = 0;
+	   age1 = 0;
+	   held = 0;
+	   held_fast = 0;
+
+	end else begin
+	   // A fast input changed. It is only correct if the raw input
+	   // had the new value just now, and the lockout after the
+	   // previous fast change is over. The lockout is counted in
+	   // ticks, so allow SLACK for that too.
+	   if (DEBOUNCED[idx] != deb_prev && FAST[idx]) begin
+	      if ((DEBOUNCED[idx]? age1 : age0) > SLACK
+		  || (held_fast && held + SLACK < FILTER)) begin
+		 spurious = spurious + 1;
+		 $display("button_check: %0t: input %0d: spurious fast change to %b (held %0d clocks)",
+			  $time, idx, DEBOUNCED[idx], held);
+	      end else begin
+		 if (fast == 0 || stable < fast_latency_min)
+		   fast_latency_min = stable;
+		 if (fast == 0 || stable > fast_latency_max)
+		   fast_latency_max = stable;
+		 fast_latency_sum = fast_latency_sum + stable;
+		 fast = fast + 1;
+	      end
+
+	   // The debounced value changed. It is only correct if it
+	   // followed a raw value that was stable long enough.
+	   end else if (DEBOUNCED[idx] != deb_prev) begin
+	      if (DEBOUNCED[idx] != raw_prev || stable < FILTER) begin
+		 spurious = spurious + 1;
+		 $display("button_check: %0t: input %0d: spurious change to %b (raw stable %0d clocks)",
+			  $time, idx, DEBOUNCED[idx], stable);
+	      end else begin
+		 if (events == 0 || stable < latency_min)
+		   latency_min = stable;
+		 if (events == 0 || stable > latency_max)
+		   latency_max = stable;
+		 latency_sum = latency_sum + stable;
+		 events = events + 1;
+	      end
+
+	   // The raw value has been stable long enough, but the
+	   // debounced value did not follow. Report it only once.
+	   end else if (DEBOUNCED[idx] != raw_prev && stable > FILTER+SLACK && !missed_flag) begin
+	      missed = missed + 1;
+	      missed_flag = 1;
+	      $display("button_check: %0t: input %0d: missed change to %b",
+		       $time, idx, raw_prev);
+	   end
+
+	   if (RAW[idx] != raw_prev) begin
+	      stable = 0;
+	      missed_flag = 0;
+	   end else begin
+	      stable = stable + 1;
+	   end
+
+	   if (DEBOUNCED[idx] != deb_prev) begin
+	      held = 0;
+	      held_fast = FAST[idx];
+	   end else begin
+	      held = held + 1;
+	   end
+
+	   if (RAW[idx]) begin
+	      age0 = age0 + 1;
+	      age1 = 0;
+	   end else begin
+	      age0 = 0;
+	      age1 = age1 + 1;
+	   end
+
+	   raw_prev = RAW[idx];
+	   deb_prev = DEBOUNCED[idx];
+	end
+   end endgenerate
+
+endmodule // button_check
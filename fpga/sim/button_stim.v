@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+`default_nettype none
+`timescale 1ps/1ps
+
+/*
+ * This generates bouncing edges on a set of user inputs, to stand in
+ * for the buttons and switches of the real board. Each input is driven
+ * by its own random process: it holds its value for a random number of
+ * clocks, then bounces a random number of times with glitches of
+ * random width, then settles at the new value. Some of the hold times
+ * are shorter than the debounce filter, so the filter gets exercised
+ * as well as the edges.
+ *
+ * The generator is off unless the +stim-enable plusarg is given, so
+ * that the inputs stay quiet for tests that don't expect them to
+ * change. These plusargs override the parameters:
+ *
+ *   +stim-seed=<N>          Seed for the random processes
+ *   +stim-hold=<N>          Maximum clocks between edges
+ *   +stim-bounces=<N>       Maximum glitches per edge
+ *   +stim-bounce-width=<N>  Maximum clocks per glitch
+ *
+ * The same seed always gives the same stimulus.
+ */
+module button_stim
+  #(parameter WIDTH = 8,
+    parameter SEED = 1,
+    parameter HOLD_MAX = 200000,
+    parameter BOUNCE_MAX = 8,
+    parameter BOUNCE_WIDTH_MAX = 1000
+    /* */)
+   (input wire CLOCK,
+    output reg [WIDTH-1:0] OUT
+    /* */);
+
+   reg     enable;
+   integer seed;
+   integer hold_max;
+   integer bounce_max;
+   integer bounce_width_max;
+
+   initial begin
+      OUT = {WIDTH{1'b0}};
+      enable = $test$plusargs("stim-enable");
+      if (! $value$plusargs("stim-seed=%d", seed))
+	seed = SEED;
+      if (! $value$plusargs("stim-hold=%d", hold_max))
+	hold_max = HOLD_MAX;
+      if (! $value$plusargs("stim-bounces=%d", bounce_max))
+	bounce_max = BOUNCE_MAX;
+      if (! $value$plusargs("stim-bounce-width=%d", bounce_width_max))
+	bounce_width_max = BOUNCE_WIDTH_MAX;
+
+      if (enable)
+	$display("button_stim: seed=%0d hold<=%0d bounces<=%0d bounce-width<=%0d",
+		 seed, hold_max, bounce_max, bounce_width_max);
+   end
+
+   genvar idx;
+   generate for (idx = 0 ; idx < WIDTH ; idx = idx + 1) begin : input_gen
+      integer bit_seed;
+      integer count;
+
+      initial begin
+	 // Let the plusargs be read.
+	 @(posedge CLOCK);
+	 bit_seed = seed * WIDTH + idx;
+	 while (enable) begin
+	    count = 1 + $unsigned($random(bit_seed)) % hold_max;
+	    repeat (count) @(posedge CLOCK);
+
+	    count = $unsigned($random(bit_seed)) % (bounce_max + 1);
+	    repeat (count) begin
+	       OUT[idx] <= ~OUT[idx];
+	       repeat (1 + $unsigned($random(bit_seed)) % bounce_width_max) @(posedge CLOCK);
+	       OUT[idx] <= ~OUT[idx];
+	       repeat (1 + $unsigned($random(bit_seed)) % bounce_width_max) @(posedge CLOCK);
+	    end
+
+	    OUT[idx] <= ~OUT[idx];
+	 end
+      end
+   end endgenerate
+
+endmodule // button_stim
@@ -0,0 +1,76 @@
+#ifndef __slf_bus_H
+#define __slf_bus_H
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is the interface that the test scenarios use to get at the
+ * SLF_FPGA device. The simulation engine binds it to a simulation of
+ * the device, so that the same scenarios can run against any of them.
+ */
+# include  <stdint.h>
+
+/*
+ * These are addresses on the AXI4 bus
+ */
+const uint32_t SLF_BUILD = 0x000000;
+const uint32_t SLF_LEDs  = 0x000004;
+const uint32_t SLF_UserIn     = 0x000008;
+const uint32_t SLF_UserInExp  = 0x00000c;
+const uint32_t SLF_UserInIEN  = 0x000010;
+const uint32_t SLF_IrqModerate= 0x000014;
+const uint32_t SLF_CycleCount = 0x000018;
+const uint32_t SLF_FifoStatus = 0x00001c;
+const uint32_t SLF_FifoPop    = 0x000020;
+const uint32_t SLF_CycleCountHi = 0x000024;
+const uint32_t SLF_IrqStamp   = 0x000028;
+const uint32_t SLF_IrqStampHi = 0x00002c;
+const uint32_t SLF_DebounceControl = 0x000048;
+const uint32_t SLF_DebounceTick    = 0x00004c;
+const uint32_t SLF_InterruptStatus = 0x000050;
+const uint32_t SLF_InterruptEdge   = 0x000054;
+const uint32_t SLF_CycleCountPeek  = 0x000058;
+const uint32_t SLF_IrqStampPeek    = 0x00005c;
+
+/*
+ * These addresses are not in the device, which ignores them. The
+ * simulation test bench watches for writes to them. See SLF_SIM.v.
+ */
+const uint32_t SIM_DumpCtl     = 0xfffff0;
+const uint32_t SIM_UserInForce = 0xfffff4;
+
+class slf_bus {
+
+    public:
+      virtual ~slf_bus() { }
+
+	// Register access. These block until the transaction is
+	// complete.
+      virtual uint32_t read32(uint64_t addr) =0;
+      virtual void write32(uint64_t addr, uint32_t data) =0;
+
+	// Let the given number of clocks pass. If irq_mask is not
+	// nil, then it is the mask of interrupts to wait for. The
+	// wait may return early if any of those interrupts are
+	// active, and on return the mask is set to the interrupts
+	// that are active.
+      virtual void wait(unsigned clocks, uint32_t*irq_mask) =0;
+};
+
+#endif
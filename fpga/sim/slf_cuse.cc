@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is a user mode stand-in for the slf_fpga device driver. It uses
+ * CUSE to create a character device (/dev/slf_fpga0 by default) that
+ * implements the SLF_FPGA_LEDS, SLF_FPGA_UserIn and SLF_FPGA_WAIT
+ * ioctls of slf_fpga.h, and turns them into AXI4 transactions against
+ * the simulated device. The simulated interrupt wakes up the waiters,
+ * the same as the real interrupt does in the driver. That way, the
+ * unmodified applications can be run and profiled against the RTL on
+ * any Linux machine.
+ *
+ *   slf_cuse [--port=<simbus port>] [--name=<dev name>]
+ *            [--idle-clocks=<N>] [<fuse options>...]
+ *
+ * This takes the place of slf_master in the bus file (see
+ * slf_cuse.bus). Creating a CUSE device needs access to /dev/cuse,
+ * which is normally only root. The fuse options are passed on to
+ * libfuse, so for example -f keeps it in the foreground and -d
+ * prints the requests.
+ *
+ * The simbus connection is only used by a single thread, the bus
+ * thread. The CUSE requests are queued for the bus thread, which runs
+ * them between slices of simulation time. A WAIT that cannot be
+ * satisfied right away is kept on a list until an interrupt shows that
+ * the inputs changed, or it is interrupted. The timeout_ms of a WAIT
+ * is ignored, the same as the driver ignores it. CUSE cannot restart
+ * an interrupted request, so a WAIT that is interrupted by a signal
+ * fails with EINTR.
+ */
+
+# define FUSE_USE_VERSION 31
+# include  <cuse_lowlevel.h>
+# include  "slf_simbus.h"
+# include  "slf_fpga.h"
+# include  <cassert>
+# include  <cerrno>
+# include  <condition_variable>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <list>
+# include  <mutex>
+# include  <string>
+# include  <thread>
+
+const unsigned slf_addr_width = 24;
+
+struct slf_cuse_request {
+      fuse_req_t req;
+      unsigned cmd;
+      union {
+	    struct slf_fpga_leds_s leds;
+	    struct slf_fpga_wait_s wait;
+      } arg;
+	// A unique id, for matching up interrupts.
+      uint64_t id;
+};
+
+/*
+ * This is the state shared by the CUSE threads and the bus thread.
+ */
+class slf_cuse_device {
+
+    public:
+      explicit slf_cuse_device(unsigned idle_clocks)
+      : idle_clocks_(idle_clocks), done_(false) { }
+
+	// Called by the CUSE threads to pass a request to the bus
+	// thread. The bus thread replies and deletes the request.
+      void submit(slf_cuse_request*req);
+      void interrupt(uint64_t id);
+      void stop();
+
+	// The bus thread runs here until stop() is called.
+      void run(slf_bus&bus);
+
+    private:
+      void start_request_(slf_bus&bus, slf_cuse_request*req);
+      void wake_waiters_(slf_bus&bus, uint32_t user_in);
+      void reply_wait_(slf_cuse_request*req, uint32_t user_in, int err);
+
+    private:
+      unsigned idle_clocks_;
+
+      std::mutex lock_;
+	// Requests that the bus thread has not seen yet.
+      std::list<slf_cuse_request*> queue_;
+	// Ids of requests that are cancelled by the caller.
+      std::list<uint64_t> interrupted_;
+      bool done_;
+
+	// WAIT requests that are blocked. Only the bus thread uses
+	// this list, so it is not locked.
+      std::list<slf_cuse_request*> waiters_;
+};
+
+void slf_cuse_device::submit(slf_cuse_request*req)
+{
+      std::lock_guard<std::mutex> guard (lock_);
+      queue_.push_back(req);
+}
+
+void slf_cuse_device::interrupt(uint64_t id)
+{
+      std::lock_guard<std::mutex> guard (lock_);
+      interrupted_.push_back(id);
+}
+
+void slf_cuse_device::stop()
+{
+      std::lock_guard<std::mutex> guard (lock_);
+      done_ = true;
+}
+
+void slf_cuse_device::reply_wait_(slf_cuse_request*req, uint32_t user_in, int err)
+{
+      if (err) {
+	    fuse_reply_err(req->req, err);
+      } else {
+	    req->arg.wait.user_in_value = user_in;
+	    fuse_reply_ioctl(req->req, 0, &req->arg.wait, sizeof req->arg.wait);
+      }
+      delete req;
+}
+
+void slf_cuse_device::start_request_(slf_bus&bus, slf_cuse_request*req)
+{
+      switch (req->cmd) {
+	  case SLF_FPGA_LEDS:
+	    bus.write32(SLF_LEDs, req->arg.leds.led_value);
+	    fuse_reply_ioctl(req->req, 0, 0, 0);
+	    delete req;
+	    break;
+
+	  case SLF_FPGA_UserIn: {
+		struct slf_fpga_UserIn_s val;
+		val.user_in_value = bus.read32(SLF_UserIn);
+		fuse_reply_ioctl(req->req, 0, &val, sizeof val);
+		delete req;
+		break;
+	  }
+
+	  case SLF_FPGA_WAIT: {
+		uint32_t user_in = bus.read32(SLF_UserIn);
+		if (user_in != req->arg.wait.user_in_exp) {
+		      reply_wait_(req, user_in, 0);
+		      break;
+		}
+
+		  // Arm the interrupt for any change from the current
+		  // value, the same as the driver does.
+		if (waiters_.empty()) {
+		      bus.write32(SLF_UserInExp, user_in);
+		      bus.write32(SLF_UserInIEN, 0xff);
+		}
+		waiters_.push_back(req);
+		break;
+	  }
+
+	  default:
+	    fuse_reply_err(req->req, ENOTTY);
+	    delete req;
+	    break;
+      }
+}
+
+/*
+ * Complete the waiters that the user_in value satisfies. Then re-arm
+ * the interrupt if there are still waiters.
+ */
+void slf_cuse_device::wake_waiters_(slf_bus&bus, uint32_t user_in)
+{
+      for (std::list<slf_cuse_request*>::iterator cur = waiters_.begin()
+		 ; cur != waiters_.end() ; ) {
+	    slf_cuse_request*req = *cur;
+	    if (user_in != req->arg.wait.user_in_exp) {
+		  cur = waiters_.erase(cur);
+		  reply_wait_(req, user_in, 0);
+	    } else {
+		  ++ cur;
+	    }
+      }
+
+	// Writing the expected value acknowledges the interrupt.
+      bus.write32(SLF_UserInExp, user_in);
+      if (waiters_.empty())
+	    bus.write32(SLF_UserInIEN, 0x00);
+}
+
+void slf_cuse_device::run(slf_bus&bus)
+{
+      for (;;) {
+	    std::list<slf_cuse_request*> queue;
+	    std::list<uint64_t> interrupted;
+	    { std::lock_guard<std::mutex> guard (lock_);
+	      if (done_)
+		    break;
+	      queue.swap(queue_);
+	      interrupted.swap(interrupted_);
+	    }
+
+	    for (std::list<slf_cuse_request*>::iterator cur = queue.begin()
+		       ; cur != queue.end() ; ++ cur)
+		  start_request_(bus, *cur);
+
+	      // Interrupts may be for requests that were just started,
+	      // so handle them after the queue.
+	    for (std::list<uint64_t>::iterator cur = interrupted.begin()
+		       ; cur != interrupted.end() ; ++ cur) {
+		  for (std::list<slf_cuse_request*>::iterator wcur = waiters_.begin()
+			     ; wcur != waiters_.end() ; ++ wcur) {
+			if ((*wcur)->id != *cur)
+			      continue;
+			slf_cuse_request*req = *wcur;
+			waiters_.erase(wcur);
+			reply_wait_(req, 0, EINTR);
+			break;
+		  }
+	    }
+	    if (! interrupted.empty() && waiters_.empty())
+		  bus.write32(SLF_UserInIEN, 0x00);
+
+	      // Let some simulation time pass. If there are waiters,
+	      // then also watch for the interrupt.
+	    if (waiters_.empty()) {
+		  bus.wait(idle_clocks_, 0);
+	    } else {
+		  uint32_t irq_mask = 1;
+		  bus.wait(idle_clocks_, &irq_mask);
+		  wake_waiters_(bus, bus.read32(SLF_UserIn));
+	    }
+      }
+
+	// Don't leave anyone hanging.
+      while (! waiters_.empty()) {
+	    reply_wait_(waiters_.front(), 0, ENODEV);
+	    waiters_.pop_front();
+      }
+}
+
+static uint64_t next_request_id = 1;
+
+static slf_cuse_device*device_of(fuse_req_t req)
+{
+      return (slf_cuse_device*)fuse_req_userdata(req);
+}
+
+static void slf_cuse_open(fuse_req_t req, struct fuse_file_info*fi)
+{
+      fuse_reply_open(req, fi);
+}
+
+/*
+ * libfuse may call this at the same time as the bus thread replies to
+ * the request and deletes it, so the data is the request id and not
+ * the request. The bus thread ignores ids that are not waiting.
+ */
+static void slf_cuse_interrupt(fuse_req_t req, void*data)
+{
+      device_of(req)->interrupt((uint64_t)(uintptr_t)data);
+}
+
+static void slf_cuse_ioctl(fuse_req_t req, int cmd, void*, struct fuse_file_info*,
+			   unsigned flags, const void*in_buf,
+			   size_t in_bufsz, size_t)
+{
+      if (flags & FUSE_IOCTL_COMPAT) {
+	    fuse_reply_err(req, ENOSYS);
+	    return;
+      }
+
+      slf_cuse_request*creq = new slf_cuse_request;
+      creq->req = req;
+      creq->cmd = (unsigned)cmd;
+      creq->id = next_request_id++;
+      memset(&creq->arg, 0, sizeof creq->arg);
+
+	// These are restricted ioctls, so the kernel has already
+	// copied in the argument, using the size encoded in the cmd.
+      switch (creq->cmd) {
+	  case SLF_FPGA_LEDS:
+	  case SLF_FPGA_WAIT:
+	    if (in_bufsz < _IOC_SIZE(creq->cmd)) {
+		  fuse_reply_err(req, EINVAL);
+		  delete creq;
+		  return;
+	    }
+	    memcpy(&creq->arg, in_buf, _IOC_SIZE(creq->cmd));
+	    break;
+	  default:
+	    break;
+      }
+
+      if (creq->cmd == SLF_FPGA_WAIT)
+	    fuse_req_interrupt_func(req, slf_cuse_interrupt, (void*)(uintptr_t)creq->id);
+
+      device_of(req)->submit(creq);
+}
+
+int main(int argc, char*argv[])
+{
+      const char*port_string = "pipe:slf_master.pipe";
+      std::string dev_name = "DEVNAME=slf_fpga0";
+      unsigned idle_clocks = 64;
+
+	// Pick out our options, and pass the rest on to fuse.
+      int fuse_argc = 1;
+      char**fuse_argv = new char*[argc+1];
+      fuse_argv[0] = argv[0];
+      for (int arg_idx = 1 ; arg_idx < argc ; arg_idx += 1) {
+	    if (strncmp(argv[arg_idx],"--port=",7) == 0) {
+		  port_string = argv[arg_idx]+7;
+
+	    } else if (strncmp(argv[arg_idx],"--name=",7) == 0) {
+		  dev_name = std::string("DEVNAME=") + (argv[arg_idx]+7);
+
+	    } else if (strncmp(argv[arg_idx],"--idle-clocks=",14) == 0) {
+		  idle_clocks = strtoul(argv[arg_idx]+14,0,0);
+
+	    } else {
+		  fuse_argv[fuse_argc++] = argv[arg_idx];
+	    }
+      }
+      fuse_argv[fuse_argc] = 0;
+
+      if (idle_clocks == 0)
+	    idle_clocks = 1;
+
+      slf_cuse_device device (idle_clocks);
+
+      const char*dev_info_argv[1] = { dev_name.c_str() };
+      struct cuse_info ci;
+      memset(&ci, 0, sizeof ci);
+      ci.dev_info_argc = 1;
+      ci.dev_info_argv = dev_info_argv;
+
+      struct cuse_lowlevel_ops ops;
+      memset(&ops, 0, sizeof ops);
+      ops.open = slf_cuse_open;
+      ops.ioctl = slf_cuse_ioctl;
+
+	// Set up the CUSE device first, because this may daemonize.
+	// The bus is only connected in the process that remains.
+      int multithreaded = 0;
+      struct fuse_session*se = cuse_lowlevel_setup(fuse_argc, fuse_argv, &ci, &ops,
+						   &multithreaded, &device);
+      if (se == 0) {
+	    fprintf(stderr, "Unable to set up the CUSE device\n");
+	    return 1;
+      }
+
+      simbus_axi4_t bus = simbus_axi4_connect(port_string, "master",
+					      32, slf_addr_width, 4, 4, 1);
+      assert(bus);
+
+      simbus_axi4_wait(bus, 4, 0);
+      simbus_axi4_reset(bus, 8, 8);
+      simbus_axi4_wait(bus, 4, 0);
+
+      slf_simbus slf (bus);
+      std::thread bus_thread (&slf_cuse_device::run, &device, std::ref(slf));
+
+	// The requests all go through the bus thread, so there is no
+	// need for more than one CUSE thread.
+      int rc = fuse_session_loop(se);
+
+      device.stop();
+      bus_thread.join();
+      cuse_lowlevel_teardown(se);
+
+      simbus_axi4_wait(bus, 8, 0);
+      simbus_axi4_end_simulation(bus);
+
+      delete[]fuse_argv;
+      return rc == 0? 0 : 1;
+}
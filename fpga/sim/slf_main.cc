@@ -19,109 +19,94 @@
 
 /*
  * This is the simulation engine for the SandyLinux sandbox AXI device.
+ * It binds the slf_bus interface to the simbus simulation, and runs
+ * the selected test scenarios against it. The results are written as
+ * CSV, one line per scenario.
+ *
+ *   slf_master [--port=<simbus port>] [--scenario=<name>[,<name>...]]
+ *              [--count=<N>] [--clock-ns=<period>] [--csv=<path>]
+ *   slf_master --list
+ *
+ * The scenario list defaults to "all". The clock period is used to
+ * convert device clocks to simulated ns, and must match the clock in
+ * the bus file. The --list flag prints the scenario names, one per
+ * line, without connecting to the simulation.
  */
 
 # define _STDC_FORMAT_MACROS
 # include  <simbus_axi4.h>
+# include  "slf_simbus.h"
+# include  "slf_scenarios.h"
 # include  <cassert>
+# include  <cinttypes>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
 
-const char*port_string = "pipe:slf_master.pipe";
 const unsigned slf_addr_width = 24;
 
-/*
- * These are addresses on the AXI4 bus
- */
-const uint32_t SLF_BUILD = 0x000000;
-const uint32_t SLF_LEDs  = 0x000004;
-const uint32_t SLF_UserIn     = 0x000008;
-const uint32_t SLF_UserInExp  = 0x00000c;
-const uint32_t SLF_UserInIEN  = 0x000010;
-
-
-uint32_t slf_read32(simbus_axi4_t bus, uint64_t addr)
-{
-      uint32_t val;
-      simbus_axi4_resp_t axi4_rc = simbus_axi4_read32(bus, addr, 0x00, &val);
-      return val;
-}
-
-void slf_write32(simbus_axi4_t bus, uint64_t addr, uint32_t data)
-{
-      simbus_axi4_resp_t axi4_rc = simbus_axi4_write32(bus, addr, 0x00, data);
-}
-
-
 int main(int argc, char*argv[])
 {
-      int rc;
+      const char*port_string = "pipe:slf_master.pipe";
+      const char*scenarios = "all";
+      const char*csv_path = 0;
+      unsigned count = 256;
+      double clock_ns = 6.666;
+
+      for (int arg_idx = 1 ; arg_idx < argc ; arg_idx += 1) {
+	    if (strncmp(argv[arg_idx],"--port=",7) == 0) {
+		  port_string = argv[arg_idx]+7;
+
+	    } else if (strncmp(argv[arg_idx],"--scenario=",11) == 0) {
+		  scenarios = argv[arg_idx]+11;
+
+	    } else if (strncmp(argv[arg_idx],"--count=",8) == 0) {
+		  count = strtoul(argv[arg_idx]+8,0,0);
+
+	    } else if (strncmp(argv[arg_idx],"--clock-ns=",11) == 0) {
+		  clock_ns = strtod(argv[arg_idx]+11,0);
+
+	    } else if (strncmp(argv[arg_idx],"--csv=",6) == 0) {
+		  csv_path = argv[arg_idx]+6;
+
+	    } else if (strcmp(argv[arg_idx],"--list") == 0) {
+		  for (const slf_scenario*cur = slf_scenario_table ; cur->name ; cur += 1)
+			printf("%s\n", cur->name);
+		  return 0;
+
+	    } else {
+		  fprintf(stderr, "Unknown argument: %s\n", argv[arg_idx]);
+		  return 2;
+	    }
+      }
+
+      FILE*csv = stdout;
+      if (csv_path) {
+	    csv = fopen(csv_path, "w");
+	    if (csv == 0) {
+		  fprintf(stderr, "%s: Unable to open CSV file\n", csv_path);
+		  return 2;
+	    }
+      }
+
       simbus_axi4_t bus = simbus_axi4_connect(port_string, "master",
 					      32, slf_addr_width, 4, 4, 1);
       assert(bus);
 
-      printf("Wait 4 clocks...\n");
-      fflush(stdout);
       simbus_axi4_wait(bus, 4, 0);
-
-      printf("Reset bus...\n");
-      fflush(stdout);
       simbus_axi4_reset(bus, 8, 8);
-
-      uint32_t build_id = slf_read32(bus, SLF_BUILD);
-      printf("FPGA BUILD = %" PRIu32 "\n", build_id);
-
-      printf("Wait 4 clocks...\n");
-      fflush(stdout);
-      simbus_axi4_wait(bus, 4, 0);
-
-      uint32_t LEDs = slf_read32(bus, SLF_LEDs);
-      printf("LEDs = 0x%08" PRIx32 "\n", LEDs);
-
-      printf("Wait 4 clocks...\n");
-      fflush(stdout);
-      simbus_axi4_wait(bus, 4, 0);
-
-      slf_write32(bus, SLF_LEDs, 0x12345678);
-
-      LEDs = slf_read32(bus, SLF_LEDs);
-      printf("LEDs = 0x%08" PRIx32 " (s.b. 012345678)\n", LEDs);
-
-      printf("Wait 4 clocks...\n");
-      fflush(stdout);
       simbus_axi4_wait(bus, 4, 0);
 
-      uint32_t user_in = slf_read32(bus, SLF_UserIn);
-      uint32_t user_in_exp = slf_read32(bus, SLF_UserInExp);
-      uint32_t user_in_ien = slf_read32(bus, SLF_UserInIEN);
-      printf("UserIn   : 0x%08" PRIx32 "\n", user_in);
-      printf("UserInExp: 0x%08" PRIx32 "\n", user_in_exp);
-      printf("UserInIEN: 0x%08" PRIx32 "\n", user_in_ien);
-
-	// Force an interrupt to happen by setting InExp different
-	// from In, and enabling interrupts.
-      slf_write32(bus, SLF_UserInIEN, 0x000000ff);
-      slf_write32(bus, SLF_UserInExp, 0x00000011);
-      simbus_axi4_wait(bus, 4, 0);
-
-      user_in_exp = slf_read32(bus, SLF_UserInExp);
-      user_in_ien = slf_read32(bus, SLF_UserInIEN);
-      printf("UserInExp: 0x%08" PRIx32 " (s.b. 0x00000011)\n", user_in_exp);
-      printf("UserInIEN: 0x%08" PRIx32 " (s.b. 0x000000ff)\n", user_in_ien);
-
-      uint32_t irq_mask = 1;
-      rc = simbus_axi4_wait(bus, 8, &irq_mask);
-      printf("irq_mask after wait: 0x%08" PRIx32 " (expect an interrupt)\n", irq_mask);
-
-	// Now clear that interrupt.
-      slf_write32(bus, SLF_UserInExp, user_in);
+      slf_simbus slf (bus);
+      int rc = slf_scenarios_run(slf, scenarios, count, clock_ns, csv);
 
-      irq_mask = 1;
-      rc = simbus_axi4_wait(bus, 8, &irq_mask);
-      printf("irq_mask after wait: 0x%08" PRIx32 " (expect no interrupt)\n", irq_mask);
-
-      printf("Wait 8 clocks...\n");
-      fflush(stdout);
       simbus_axi4_wait(bus, 8, 0);
-
       simbus_axi4_end_simulation(bus);
-      return 0;
+
+      if (csv != stdout)
+	    fclose(csv);
+
+      if (rc < 0)
+	    return 2;
+      return rc == 0? 0 : 1;
 }
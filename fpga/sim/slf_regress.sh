@@ -0,0 +1,165 @@
+#!/bin/sh
+
+# This script runs the slf_master scenarios as a regression, with each
+# scenario in its own simulation, and as many simulations at a time as
+# there are CPUs. Run it from this directory after building (or use
+# "make regress"):
+#
+#   sh slf_regress.sh [-j <jobs>] [-o <dir>] [-c <count>] [-f] [<scenario>...]
+#
+# The default is to run all the scenarios that slf_master --list
+# reports. The -f flag selects the fast simulation (SLF_SIM_FAST).
+#
+# Each scenario gets a work directory <dir>/<scenario> (default
+# regress/<scenario>) with a generated bus file, its own simbus pipe,
+# and the logs. A scenario that fails is run a second time with the
+# +dump plusarg, so that its work directory also has the waveforms.
+# The waveforms of scenarios that pass are not kept. The results are
+# collected into <dir>/summary.csv, and the script exits non-zero if
+# any scenario failed.
+
+set -u
+
+# Run one scenario. This is invoked (by xargs, below) as a separate
+# process for each scenario, with the settings in the environment.
+run_one() {
+    scn=$1
+    plusargs=$2
+    dir=$REGRESS_OUT/$scn
+
+    rm -rf "$dir"
+    mkdir -p "$dir"
+
+    cat > "$dir/$scn.bus" <<EOF
+# AUTOMATICALLY GENERATED by slf_regress.sh -- DO NOT EDIT
+bus {
+    protocol = "AXI4";
+
+    name = "slf_master";
+    pipe = "$scn.pipe";
+
+    # This must match the --clock-ns of slf_master (150MHz).
+    CLOCK_high = 3333;
+    CLOCK_low  = 3333;
+
+    CLOCK_hold = 100;
+    CLOCK_setup = 200;
+
+    host    0 "master";
+    device  1 "SLF_REGS";
+}
+
+process {
+    name = "master";
+    exec = "$REGRESS_HERE/slf_master --port=pipe:$scn.pipe --scenario=$scn --count=$REGRESS_COUNT --csv=result.csv";
+    stdout = "master.log";
+}
+
+process {
+    name = "SLF_REGS";
+    exec = "vvp -v -msimbus $REGRESS_HERE/$REGRESS_SIM -fst -simbus-debug-mask=0 +simbus-SLF_REGS-bus=pipe:$scn.pipe $plusargs";
+    stdout = "slf_sim.log";
+}
+EOF
+
+    (cd "$dir" && simbus "$scn.bus" > simbus.log 2>&1)
+
+    if grep -q "^$scn,.*,pass\$" "$dir/result.csv" 2>/dev/null ; then
+	rm -f "$dir"/*.fst "$dir"/*.vcd
+	return 0
+    fi
+    return 1
+}
+
+if [ "${1:-}" = "--one" ] ; then
+    scn=$2
+    start=`date +%s.%N`
+    if run_one "$scn" "" ; then
+	result=pass
+    else
+	result=FAIL
+    fi
+    end=`date +%s.%N`
+
+    # Keep the timing and results of the first run, and repeat the
+    # run to get the waveforms.
+    if [ $result = FAIL ] ; then
+	mv "$REGRESS_OUT/$scn" "$REGRESS_OUT/$scn.first"
+	run_one "$scn" "+dump"
+	rm -rf "$REGRESS_OUT/$scn/result.csv"
+	mv "$REGRESS_OUT/$scn.first/result.csv" "$REGRESS_OUT/$scn/" 2>/dev/null
+	rm -rf "$REGRESS_OUT/$scn.first"
+    fi
+
+    seconds=`echo "$start $end" | awk '{ printf "%.2f", $2 - $1 }'`
+    echo "$scn,$result,$seconds" > "$REGRESS_OUT/$scn/status"
+    echo "$result $scn ($seconds s)"
+    exit 0
+fi
+
+here=`cd \`dirname "$0"\` && pwd`
+jobs=`nproc 2>/dev/null || echo 1`
+out=regress
+count=256
+sim=slf_sim.out
+
+while getopts "j:o:c:f" opt ; do
+    case $opt in
+	j) jobs=$OPTARG ;;
+	o) out=$OPTARG ;;
+	c) count=$OPTARG ;;
+	f) sim=slf_sim_fast.out ;;
+	*) exit 2 ;;
+    esac
+done
+shift `expr $OPTIND - 1`
+
+for file in slf_master $sim ; do
+    if [ ! -f "$here/$file" ] ; then
+	echo "$here/$file is missing. Run make first." 1>&2
+	exit 2
+    fi
+done
+
+if [ $# -gt 0 ] ; then
+    scenarios="$*"
+else
+    scenarios=`"$here/slf_master" --list`
+fi
+
+mkdir -p "$out"
+out=`cd "$out" && pwd`
+
+REGRESS_OUT=$out
+REGRESS_HERE=$here
+REGRESS_SIM=$sim
+REGRESS_COUNT=$count
+export REGRESS_OUT REGRESS_HERE REGRESS_SIM REGRESS_COUNT
+
+start=`date +%s.%N`
+for scn in $scenarios ; do echo "$scn" ; done | xargs -P "$jobs" -I{} sh "$here/slf_regress.sh" --one {}
+end=`date +%s.%N`
+
+# Collect the status of each scenario, and the slf_master results
+# (transactions, clocks, ...) if it got that far, into the summary.
+summary=$out/summary.csv
+echo "scenario,result,seconds,transactions,clocks,clocks_per_transaction,ns_per_transaction" > "$summary"
+pass=0
+fail=0
+for scn in $scenarios ; do
+    status=`cat "$out/$scn/status" 2>/dev/null || echo "$scn,FAIL,"`
+    row=`grep "^$scn," "$out/$scn/result.csv" 2>/dev/null | cut -d, -f2-5`
+    echo "$status,${row:-,,,}" >> "$summary"
+    case $status in
+	*,pass,*) pass=`expr $pass + 1` ;;
+	*) fail=`expr $fail + 1` ;;
+    esac
+done
+
+wall=`echo "$start $end" | awk '{ printf "%.2f", $2 - $1 }'`
+echo "$pass passed, $fail failed, $wall s with $jobs jobs. See $summary"
+
+if [ $fail -gt 0 ] ; then
+    exit 1
+fi
+exit 0
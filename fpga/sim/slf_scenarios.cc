@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "slf_scenarios.h"
+# include  <cinttypes>
+# include  <cstring>
+# include  <string>
+# include  <vector>
+
+/*
+ * Limit on how long to wait for the interrupt to change state.
+ */
+static const unsigned IRQ_TIMEOUT_CLOCKS = 256;
+
+static uint32_t cycle_count(slf_bus&bus)
+{
+      return bus.read32(SLF_CycleCount);
+}
+
+/*
+ * Wait for the interrupt line to reach the given state, one clock at
+ * a time. Return false if it takes too long.
+ */
+static bool wait_for_irq(slf_bus&bus, bool state)
+{
+      for (unsigned idx = 0 ; idx < IRQ_TIMEOUT_CLOCKS ; idx += 1) {
+	    uint32_t irq_mask = 1;
+	    bus.wait(1, &irq_mask);
+	    if ((irq_mask & 1) == (state? 1 : 0))
+		  return true;
+      }
+      return false;
+}
+
+/*
+ * This passes the transactions through to another bus, and counts
+ * them, for scenarios that have too many to count by hand.
+ */
+class slf_bus_count : public slf_bus {
+
+    public:
+      explicit slf_bus_count(slf_bus&bus) : bus_(bus), transactions_(0) { }
+
+      unsigned transactions() const { return transactions_; }
+
+      uint32_t read32(uint64_t addr)
+      {
+	    transactions_ += 1;
+	    return bus_.read32(addr);
+      }
+
+      void write32(uint64_t addr, uint32_t data)
+      {
+	    transactions_ += 1;
+	    bus_.write32(addr, data);
+      }
+
+      void wait(unsigned clocks, uint32_t*irq_mask)
+      {
+	    bus_.wait(clocks, irq_mask);
+      }
+
+    private:
+      slf_bus&bus_;
+      unsigned transactions_;
+
+    private: // not implemented
+      slf_bus_count(const slf_bus_count&);
+      slf_bus_count& operator= (const slf_bus_count&);
+};
+
+/*
+ * The basic smoke test of the registers and the interrupt. The count
+ * is ignored.
+ */
+static void run_smoke(slf_bus&bus, unsigned, slf_scenario_result&res)
+{
+      res.pass = true;
+      uint32_t start = cycle_count(bus);
+
+      bus.read32(SLF_BUILD);
+
+      bus.write32(SLF_LEDs, 0x12345678);
+      uint32_t leds = bus.read32(SLF_LEDs);
+      if (leds != 0x12345678) {
+	    fprintf(stderr, "smoke: LEDs = 0x%08" PRIx32 " (s.b. 0x12345678)\n", leds);
+	    res.pass = false;
+      }
+
+	// Force an interrupt to happen by setting InExp different
+	// from In, and enabling interrupts.
+      uint32_t user_in = bus.read32(SLF_UserIn);
+      bus.write32(SLF_UserInIEN, 0x000000ff);
+      bus.write32(SLF_UserInExp, user_in ^ 0x00000011);
+
+      uint32_t user_in_ien = bus.read32(SLF_UserInIEN);
+      if (user_in_ien != 0x000000ff) {
+	    fprintf(stderr, "smoke: UserInIEN = 0x%08" PRIx32 " (s.b. 0x000000ff)\n", user_in_ien);
+	    res.pass = false;
+      }
+
+      if (! wait_for_irq(bus, true)) {
+	    fprintf(stderr, "smoke: Expected an interrupt.\n");
+	    res.pass = false;
+      }
+
+	// Now clear that interrupt.
+      bus.write32(SLF_UserInExp, user_in);
+      if (! wait_for_irq(bus, false)) {
+	    fprintf(stderr, "smoke: Interrupt did not clear.\n");
+	    res.pass = false;
+      }
+
+      bus.write32(SLF_UserInIEN, 0x00000000);
+
+      res.clocks = cycle_count(bus) - start;
+      res.transactions = 9;
+}
+
+/*
+ * Back-to-back reads of the same register.
+ */
+static void run_reads(slf_bus&bus, unsigned count, slf_scenario_result&res)
+{
+      bus.write32(SLF_LEDs, 0x5a5a5a5a);
+
+      res.pass = true;
+      uint32_t start = cycle_count(bus);
+      for (unsigned idx = 0 ; idx < count ; idx += 1) {
+	    if (bus.read32(SLF_LEDs) != 0x5a5a5a5a)
+		  res.pass = false;
+      }
+      res.clocks = cycle_count(bus) - start;
+      res.transactions = count;
+
+      if (! res.pass)
+	    fprintf(stderr, "reads: Read back the wrong LEDs value.\n");
+}
+
+/*
+ * Back-to-back writes to the same register, with a read at the end to
+ * make sure the last write landed.
+ */
+static void run_writes(slf_bus&bus, unsigned count, slf_scenario_result&res)
+{
+      uint32_t start = cycle_count(bus);
+      for (unsigned idx = 0 ; idx < count ; idx += 1)
+	    bus.write32(SLF_LEDs, idx);
+      res.clocks = cycle_count(bus) - start;
+      res.transactions = count;
+
+      uint32_t leds = bus.read32(SLF_LEDs);
+      res.pass = count == 0 || leds == count-1;
+      if (! res.pass)
+	    fprintf(stderr, "writes: LEDs = 0x%08" PRIx32 " (s.b. 0x%08x)\n", leds, count-1);
+}
+
+/*
+ * Alternating writes and reads, with each read checking the write
+ * before it.
+ */
+static void run_mixed(slf_bus&bus, unsigned count, slf_scenario_result&res)
+{
+      res.pass = true;
+      uint32_t start = cycle_count(bus);
+      for (unsigned idx = 0 ; idx < count ; idx += 1) {
+	    uint32_t val = idx * 0x01010101;
+	    bus.write32(SLF_LEDs, val);
+	    if (bus.read32(SLF_LEDs) != val)
+		  res.pass = false;
+      }
+      res.clocks = cycle_count(bus) - start;
+      res.transactions = 2*count;
+
+      if (! res.pass)
+	    fprintf(stderr, "mixed: Read back the wrong LEDs value.\n");
+}
+
+/*
+ * Interrupt round trips. Each round trip forces a UserInExp mismatch,
+ * waits for the interrupt to show up, then clears it and waits for it
+ * to go away again. This is what the driver ISR does for every input
+ * change, apart from the FIFO handling.
+ */
+static void run_irq(slf_bus&bus, unsigned count, slf_scenario_result&res)
+{
+      bus.write32(SLF_IrqModerate, 0x00000000);
+      bus.write32(SLF_UserInIEN, 0x000000ff);
+      uint32_t user_in = bus.read32(SLF_UserIn);
+      bus.write32(SLF_UserInExp, user_in);
+
+      res.pass = wait_for_irq(bus, false);
+      uint32_t start = cycle_count(bus);
+      unsigned idx;
+      for (idx = 0 ; res.pass && idx < count ; idx += 1) {
+	    bus.write32(SLF_UserInExp, user_in ^ 0x00000001);
+	    if (! wait_for_irq(bus, true)) {
+		  fprintf(stderr, "irq: Timed out waiting for the interrupt.\n");
+		  res.pass = false;
+		  break;
+	    }
+
+	    bus.write32(SLF_UserInExp, user_in);
+	    if (! wait_for_irq(bus, false)) {
+		  fprintf(stderr, "irq: Timed out waiting for the interrupt to clear.\n");
+		  res.pass = false;
+		  break;
+	    }
+      }
+      res.clocks = cycle_count(bus) - start;
+      res.transactions = idx;
+
+      bus.write32(SLF_UserInIEN, 0x00000000);
+}
+
+/*
+ * Drive the inputs through the simulation test bench. The value goes
+ * to the raw inputs on the clock after the write lands.
+ */
+static void force_user_in(slf_bus&bus, uint32_t val)
+{
+      bus.write32(SIM_UserInForce, 0x80000000 | val);
+}
+
+/*
+ * Check the Changed flags and the interrupt against what they should
+ * be, for run_latched.
+ */
+static bool latched_expect(slf_bus&bus, const char*what, uint32_t changed, bool irq)
+{
+      bool ok = true;
+      uint32_t status = bus.read32(SLF_InterruptStatus);
+      if ((status & 0xff) != changed) {
+	    fprintf(stderr, "latched: %s: InterruptStatus = 0x%08" PRIx32
+		    " (Changed s.b. 0x%02" PRIx32 ")\n", what, status, changed);
+	    ok = false;
+      }
+
+      if (! wait_for_irq(bus, irq)) {
+	    fprintf(stderr, "latched: %s: Interrupt is %s (s.b. %s)\n", what,
+		    irq? "clear" : "set", irq? "set" : "clear");
+	    ok = false;
+      }
+      return ok;
+}
+
+/*
+ * Clocks from a forced change of a Fast input to the update of its
+ * Changed flag: two clocks of synchronizer, one for the debounce
+ * output, and one for the edge detect.
+ */
+static const uint32_t FAST_EDGE_CLOCKS = 4;
+
+/*
+ * Measure the clocks from the first to the last of a sequence of
+ * writes, a forced input change, fill writes of UserInExp, and
+ * another forced change. Both changes are Fast edges, so the change
+ * FIFO timestamps are the same number of clocks after the writes.
+ */
+static bool latched_write_spacing(slf_bus&bus, unsigned fill, unsigned settle,
+				  uint32_t&spacing)
+{
+      bus.write32(SLF_FifoStatus, 0xc0000000);
+      force_user_in(bus, 0x40);
+      for (unsigned idx = 0 ; idx < fill ; idx += 1)
+	    bus.write32(SLF_UserInExp, 0x00000000);
+      force_user_in(bus, 0xc0);
+      bus.wait(settle, 0);
+
+      bool ok = true;
+      uint32_t level = bus.read32(SLF_FifoStatus) & 0x1ff;
+      if (level != 2) {
+	    fprintf(stderr, "latched: %" PRIu32 " changes in write spacing (s.b. 2)\n", level);
+	    ok = false;
+      } else {
+	    uint32_t first = bus.read32(SLF_FifoPop);
+	    uint32_t last  = bus.read32(SLF_FifoPop);
+	    spacing = ((last >> 8) - (first >> 8)) & 0x00ffffff;
+      }
+
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+      bus.write32(SLF_FifoStatus, 0xc0000000);
+      bus.write32(SLF_InterruptStatus, 0x000000ff);
+      return ok;
+}
+
+/*
+ * Force input 5 to the value, held off by the delay, then do the
+ * same fill writes as latched_write_spacing, then clear the flag of
+ * input 5.
+ */
+static void latched_edge_and_clear(slf_bus&bus, uint32_t val, unsigned fill, uint32_t delay)
+{
+      bus.write32(SIM_UserInForce, 0x80000000 | (delay << 16) | val);
+      for (unsigned idx = 0 ; idx < fill ; idx += 1)
+	    bus.write32(SLF_UserInExp, 0x00000000);
+      bus.write32(SLF_InterruptStatus, 0x00000020);
+}
+
+/*
+ * Check the latched interrupt mode. Without input changes there are
+ * no change flags, so there should be no interrupt even though
+ * UserInExp mismatches, and the status should carry the current
+ * UserIn. Then drive the inputs with the SIM_UserInForce test bench
+ * address, and check that an enabled edge sets a flag that stays set
+ * until it is written with a 1, that writing 1 clears only that flag,
+ * and that the rising and falling enables pick the edges. All the
+ * inputs are set Fast with a short filter, so that the edges come
+ * through quickly. Last, an input edge is timed to reach the flags
+ * on the same clock as the write that clears its flag, and the flag
+ * should stay set. The count is ignored. The transactions are all
+ * the register reads and writes, counted as they go.
+ */
+static void run_latched(slf_bus&dev, unsigned, slf_scenario_result&res)
+{
+      slf_bus_count bus (dev);
+      res.pass = true;
+      uint32_t start = cycle_count(bus);
+
+      uint32_t edge = bus.read32(SLF_InterruptEdge);
+      if (edge != 0x0000ffff) {
+	    fprintf(stderr, "latched: InterruptEdge = 0x%08" PRIx32 " (s.b. 0x0000ffff)\n", edge);
+	    res.pass = false;
+      }
+
+      uint32_t tick = bus.read32(SLF_DebounceTick);
+      uint32_t debounce_control = bus.read32(SLF_DebounceControl);
+      bus.write32(SLF_DebounceControl, 0x00ff0002);
+	// A Fast edge takes a few clocks, and the lockout after it
+	// takes the filter time.
+      unsigned settle = 4*tick + 16;
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+
+      bus.write32(SLF_IrqModerate, 0x00000000);
+      bus.write32(SLF_InterruptEdge, 0x8000ffff);
+      bus.write32(SLF_InterruptStatus, 0x000000ff);
+
+      uint32_t user_in = bus.read32(SLF_UserIn);
+      bus.write32(SLF_UserInExp, user_in ^ 0x00000011);
+      bus.write32(SLF_UserInIEN, 0x000000ff);
+
+      uint32_t status = bus.read32(SLF_InterruptStatus);
+      if (((status >> 8) & 0xff) != (user_in & 0xff)) {
+	    fprintf(stderr, "latched: InterruptStatus = 0x%08" PRIx32
+		    " (UserIn s.b. 0x%02" PRIx32 ")\n", status, user_in & 0xff);
+	    res.pass = false;
+      }
+
+      if (! wait_for_irq(bus, false)) {
+	    fprintf(stderr, "latched: Unexpected interrupt.\n");
+	    res.pass = false;
+      }
+
+	// An edge sets its flag, and the flag stays set after the
+	// input goes back.
+      force_user_in(bus, 0x01);
+      bus.wait(settle, 0);
+      res.pass &= latched_expect(bus, "rise 0", 0x01, true);
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+      res.pass &= latched_expect(bus, "fall 0", 0x01, true);
+
+	// Writing 1 clears only that flag.
+      force_user_in(bus, 0x02);
+      bus.wait(settle, 0);
+      res.pass &= latched_expect(bus, "rise 1", 0x03, true);
+      bus.write32(SLF_InterruptStatus, 0x00000001);
+      res.pass &= latched_expect(bus, "clear 0", 0x02, true);
+      bus.write32(SLF_InterruptStatus, 0x00000002);
+      res.pass &= latched_expect(bus, "clear 1", 0x00, false);
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+      bus.write32(SLF_InterruptStatus, 0x000000ff);
+
+	// Enable only rising edges of input 2 and falling edges of
+	// input 3.
+      bus.write32(SLF_InterruptEdge, 0x80000804);
+      force_user_in(bus, 0x04);
+      bus.wait(settle, 0);
+      res.pass &= latched_expect(bus, "rise 2", 0x04, true);
+      bus.write32(SLF_InterruptStatus, 0x00000004);
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+      res.pass &= latched_expect(bus, "fall 2", 0x00, false);
+      force_user_in(bus, 0x08);
+      bus.wait(settle, 0);
+      res.pass &= latched_expect(bus, "rise 3", 0x00, false);
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+      res.pass &= latched_expect(bus, "fall 3", 0x08, true);
+      bus.write32(SLF_InterruptStatus, 0x00000008);
+      bus.write32(SLF_InterruptEdge, 0x8000ffff);
+
+	// An edge on the same clock as the clear of its flag wins.
+	// The bus can't choose the clock of a write, so measure the
+	// clocks from a forced change to a later write, with enough
+	// fill writes in between to cover the edge time. Then hold
+	// the forced change of input 5 off so that its edge reaches
+	// the flags on the clock of the clear. An edge one clock
+	// earlier must be cleared, which shows that the timing is
+	// right, so that the flag staying set shows that the edge wins.
+      unsigned fill;
+      uint32_t spacing = 0;
+      for (fill = 0 ; fill < 4 ; fill += 1) {
+	    if (! latched_write_spacing(bus, fill, settle, spacing))
+		  break;
+	    if (spacing > FAST_EDGE_CLOCKS && spacing - FAST_EDGE_CLOCKS <= 0xff)
+		  break;
+      }
+      if (spacing <= FAST_EDGE_CLOCKS || spacing - FAST_EDGE_CLOCKS > 0xff) {
+	    fprintf(stderr, "latched: Write spacing %" PRIu32 " clocks, "
+		    "can't time an edge on the clear.\n", spacing);
+	    res.pass = false;
+      } else {
+	    uint32_t delay = spacing - FAST_EDGE_CLOCKS;
+	    latched_edge_and_clear(bus, 0x20, fill, delay - 1);
+	    bus.wait(settle, 0);
+	    res.pass &= latched_expect(bus, "edge before clear", 0x00, false);
+	    latched_edge_and_clear(bus, 0x00, fill, delay);
+	    bus.wait(settle, 0);
+	    res.pass &= latched_expect(bus, "edge on clear", 0x20, true);
+	    bus.write32(SLF_InterruptStatus, 0x00000020);
+	    res.pass &= latched_expect(bus, "clear 5", 0x00, false);
+      }
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+
+      bus.write32(SLF_UserInIEN, 0x00000000);
+      bus.write32(SLF_UserInExp, user_in);
+      bus.write32(SLF_InterruptEdge, 0x0000ffff);
+      bus.write32(SLF_DebounceControl, debounce_control);
+      bus.write32(SIM_UserInForce, 0x00000000);
+      bus.write32(SLF_FifoStatus, 0xc0000000);
+      bus.write32(SLF_InterruptStatus, 0x000000ff);
+
+      res.clocks = cycle_count(bus) - start;
+      res.transactions = bus.transactions();
+}
+
+/*
+ * Force the inputs from one value to another, with a bounce back and
+ * forth on the way, and let the debounce settle. The change FIFO
+ * should show exactly one change, to the new value. The latency of
+ * the change is from just before the first forced edge to the FIFO
+ * timestamp. A Fast input should change well within the filter time,
+ * and any other input should take at least the filter time.
+ */
+static bool debounce_edge(slf_bus&bus, uint32_t from, uint32_t to, bool fast,
+			  uint32_t filter_clocks, unsigned settle,
+			  slf_scenario_result&res)
+{
+      uint32_t start = cycle_count(bus);
+      force_user_in(bus, to);
+      force_user_in(bus, from);
+      force_user_in(bus, to);
+      bus.wait(settle, 0);
+
+      uint32_t level = bus.read32(SLF_FifoStatus) & 0x1ff;
+      if (level != 1) {
+	    fprintf(stderr, "debounce: %" PRIu32 " changes for 0x%02" PRIx32
+		    " -> 0x%02" PRIx32 " (s.b. 1)\n", level, from, to);
+	    bus.write32(SLF_FifoStatus, 0xc0000000);
+	    return false;
+      }
+
+      uint32_t entry = bus.read32(SLF_FifoPop);
+      if ((entry & 0xff) != to) {
+	    fprintf(stderr, "debounce: FifoPop = 0x%08" PRIx32 " (UserIn s.b. 0x%02" PRIx32 ")\n",
+		    entry, to);
+	    return false;
+      }
+
+      uint32_t latency = ((entry >> 8) - start) & 0x00ffffff;
+      if (fast && latency >= filter_clocks) {
+	    fprintf(stderr, "debounce: Fast 0x%02" PRIx32 " -> 0x%02" PRIx32
+		    " took %" PRIu32 " clocks (s.b. < %" PRIu32 ")\n",
+		    from, to, latency, filter_clocks);
+	    return false;
+      }
+      if (!fast && latency < filter_clocks) {
+	    fprintf(stderr, "debounce: 0x%02" PRIx32 " -> 0x%02" PRIx32
+		    " took %" PRIu32 " clocks (s.b. >= %" PRIu32 ")\n",
+		    from, to, latency, filter_clocks);
+	    return false;
+      }
+
+      if (fast) {
+	    res.transactions += 1;
+	    res.clocks += latency;
+      }
+      return true;
+}
+
+/*
+ * Check the debounce filter and the Fast mode. Input 0 is set Fast
+ * and input 1 is not, and each is pressed and released with a bounce
+ * on every edge. The filter is set to a bit more than the time of the
+ * bounce, so that the test takes a reasonable time even with the real
+ * filter. The inputs are driven with the SIM_UserInForce test bench
+ * address, so this needs a bus that implements it. The count is the
+ * number of press/release rounds, up to DEBOUNCE_ROUNDS_MAX, since
+ * each edge waits out the filter. The transactions are the Fast edges
+ * and the clocks are their total latency, so the clocks per
+ * transaction is the mean Fast press latency.
+ */
+static const unsigned DEBOUNCE_ROUNDS_MAX = 16;
+static const uint32_t DEBOUNCE_FILTER_CLOCKS = 64;
+
+static void run_debounce(slf_bus&bus, unsigned count, slf_scenario_result&res)
+{
+      res.pass = true;
+
+      uint32_t tick = bus.read32(SLF_DebounceTick);
+      uint32_t filter = (DEBOUNCE_FILTER_CLOCKS + tick - 1) / tick;
+      if (filter < 2)
+	    filter = 2;
+      if (filter > 255)
+	    filter = 255;
+      uint32_t filter_clocks = filter * tick;
+	// The filter passes a change between Filter and Filter+1
+	// ticks after the last edge, plus the synchronizer.
+      unsigned settle = filter_clocks + 2*tick + 16;
+
+      uint32_t debounce_control = bus.read32(SLF_DebounceControl);
+      bus.write32(SLF_DebounceControl, 0x00010000 | filter);
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+      bus.write32(SLF_FifoStatus, 0xc0000000);
+
+      if (count > DEBOUNCE_ROUNDS_MAX)
+	    count = DEBOUNCE_ROUNDS_MAX;
+
+      for (unsigned idx = 0 ; res.pass && idx < count ; idx += 1) {
+	    if (! debounce_edge(bus, 0x00, 0x01, true,  filter_clocks, settle, res))
+		  res.pass = false;
+	    else if (! debounce_edge(bus, 0x01, 0x00, true,  filter_clocks, settle, res))
+		  res.pass = false;
+	    else if (! debounce_edge(bus, 0x00, 0x02, false, filter_clocks, settle, res))
+		  res.pass = false;
+	    else if (! debounce_edge(bus, 0x02, 0x00, false, filter_clocks, settle, res))
+		  res.pass = false;
+      }
+
+	// Put the inputs back to rest before the filter goes back to
+	// its old setting, then give them back to the stimulus.
+      force_user_in(bus, 0x00);
+      bus.wait(settle, 0);
+      bus.write32(SLF_DebounceControl, debounce_control);
+      bus.write32(SIM_UserInForce, 0x00000000);
+      bus.write32(SLF_FifoStatus, 0xc0000000);
+      bus.write32(SLF_InterruptStatus, 0x000000ff);
+}
+
+const slf_scenario slf_scenario_table[] = {
+      { "smoke",  "Basic register and interrupt checks",  run_smoke },
+      { "reads",  "Back-to-back register reads",          run_reads },
+      { "writes", "Back-to-back register writes",         run_writes },
+      { "mixed",  "Alternating register writes and reads", run_mixed },
+      { "irq",    "Interrupt assert/clear round trips",   run_irq },
+      { "latched", "Latched interrupt status mode",       run_latched },
+      { "debounce", "Debounce filter and Fast mode latency", run_debounce },
+      { 0, 0, 0 }
+};
+
+const slf_scenario*slf_scenario_find(const char*name)
+{
+      for (const slf_scenario*cur = slf_scenario_table ; cur->name ; cur += 1) {
+	    if (strcmp(cur->name, name) == 0)
+		  return cur;
+      }
+      return 0;
+}
+
+static void csv_row(FILE*csv, const slf_scenario*scn, const slf_scenario_result&res,
+		    double clock_ns)
+{
+      double per = res.transactions? (double)res.clocks / (double)res.transactions : 0.0;
+      fprintf(csv, "%s,%u,%" PRIu32 ",%.3f,%.3f,%s\n", scn->name,
+	      res.transactions, res.clocks, per, per * clock_ns,
+	      res.pass? "pass" : "FAIL");
+      fflush(csv);
+}
+
+int slf_scenarios_run(slf_bus&bus, const char*list, unsigned count,
+		      double clock_ns, FILE*csv)
+{
+      std::vector<const slf_scenario*> run;
+
+      if (strcmp(list, "all") == 0) {
+	    for (const slf_scenario*cur = slf_scenario_table ; cur->name ; cur += 1)
+		  run.push_back(cur);
+
+      } else {
+	    std::string names (list);
+	    size_t pos = 0;
+	    while (pos <= names.size()) {
+		  size_t end = names.find(',', pos);
+		  if (end == std::string::npos)
+			end = names.size();
+		  std::string name = names.substr(pos, end-pos);
+		  const slf_scenario*cur = slf_scenario_find(name.c_str());
+		  if (cur == 0) {
+			fprintf(stderr, "Unknown scenario: %s\n", name.c_str());
+			return -1;
+		  }
+		  run.push_back(cur);
+		  pos = end + 1;
+	    }
+      }
+
+      fprintf(csv, "scenario,transactions,clocks,clocks_per_transaction,ns_per_transaction,result\n");
+
+      int fail_count = 0;
+      for (size_t idx = 0 ; idx < run.size() ; idx += 1) {
+	    slf_scenario_result res;
+	    res.transactions = 0;
+	    res.clocks = 0;
+	    res.pass = false;
+	    run[idx]->run(bus, count, res);
+	    csv_row(csv, run[idx], res, clock_ns);
+	    if (! res.pass)
+		  fail_count += 1;
+      }
+
+      return fail_count;
+}
@@ -0,0 +1,64 @@
+#ifndef __slf_scenarios_H
+#define __slf_scenarios_H
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The test and benchmark scenarios for the SLF_FPGA device. Each
+ * scenario runs a number of iterations of some bus activity, checks
+ * the results, and measures how many device clocks it took. The
+ * CycleCount register provides the clock count, so the measurement
+ * includes the full round trip through the simulation engine.
+ */
+# include  "slf_bus.h"
+# include  <cstdio>
+
+struct slf_scenario_result {
+	// Number of transactions (or round trips) performed.
+      unsigned transactions;
+	// Device clocks that the transactions took.
+      uint32_t clocks;
+	// True if all the checks passed.
+      bool pass;
+};
+
+struct slf_scenario {
+      const char*name;
+      const char*description;
+      void (*run)(slf_bus&bus, unsigned count, slf_scenario_result&res);
+};
+
+/*
+ * The table of scenarios, terminated by an entry with a nil name.
+ */
+extern const slf_scenario slf_scenario_table[];
+
+extern const slf_scenario*slf_scenario_find(const char*name);
+
+/*
+ * Run the scenarios named in the comma separated list, or all of them
+ * if the list is "all", and write a line of CSV for each to the csv
+ * file. The clock_ns is the period of the device clock, used to
+ * convert clocks to simulated time. Return the number of scenarios
+ * that failed, or <0 if the list names a scenario that doesn't exist.
+ */
+extern int slf_scenarios_run(slf_bus&bus, const char*list, unsigned count,
+			     double clock_ns, FILE*csv);
+
+#endif
@@ -3,6 +3,10 @@
 # This is the simulation root module.
 SLF_SIM.v
 
+# User input stimulus and checking.
+button_stim.v
+button_check.v
+
 # This is to simulate Xilinx loading.
 #$(XILINX_VER)/glbl.v
 
@@ -0,0 +1,63 @@
+#ifndef __slf_simbus_H
+#define __slf_simbus_H
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This binds the slf_bus interface to a simbus AXI4 master port. The
+ * port must already be connected and out of reset.
+ */
+# define _STDC_FORMAT_MACROS
+# include  <simbus_axi4.h>
+# include  "slf_bus.h"
+# include  <cinttypes>
+# include  <cstdio>
+
+class slf_simbus : public slf_bus {
+
+    public:
+      explicit slf_simbus(simbus_axi4_t bus) : bus_(bus) { }
+      ~slf_simbus() { }
+
+      uint32_t read32(uint64_t addr)
+      {
+	    uint32_t val;
+	    simbus_axi4_resp_t axi4_rc = simbus_axi4_read32(bus_, addr, 0x00, &val);
+	    if (axi4_rc != SIMBUS_AXI4_RESP_OKAY)
+		  fprintf(stderr, "read32(0x%06" PRIx64 "): resp=%d\n", addr, (int)axi4_rc);
+	    return val;
+      }
+
+      void write32(uint64_t addr, uint32_t data)
+      {
+	    simbus_axi4_resp_t axi4_rc = simbus_axi4_write32(bus_, addr, 0x00, data);
+	    if (axi4_rc != SIMBUS_AXI4_RESP_OKAY)
+		  fprintf(stderr, "write32(0x%06" PRIx64 "): resp=%d\n", addr, (int)axi4_rc);
+      }
+
+      void wait(unsigned clocks, uint32_t*irq_mask)
+      {
+	    simbus_axi4_wait(bus_, clocks, irq_mask);
+      }
+
+    private:
+      simbus_axi4_t bus_;
+};
+
+#endif
@@ -18,17 +18,33 @@
  */
 
 # include  <linux/module.h>
+# include  <linux/debugfs.h>
 # include  <linux/of_device.h>
 # include  <linux/fs.h>
+# include  <linux/hrtimer.h>
 # include  <linux/interrupt.h>
 # include  <linux/io.h>
+# include  <linux/kref.h>
+# include  <linux/log2.h>
+# include  <linux/mm.h>
+# include  <linux/mutex.h>
+# include  <linux/poll.h>
+# include  <linux/rwsem.h>
 # include  <linux/sched.h>
 # include  <linux/sched/signal.h>
+# include  <linux/seq_file.h>
+# include  <linux/slab.h>
+# include  <linux/spinlock.h>
+# include  <linux/timekeeping.h>
 # include  <linux/uaccess.h>
+# include  <linux/version.h>
 # include  <linux/wait.h>
 
 # include  "slf_fpga.h"
 
+# define CREATE_TRACE_POINTS
+# include  "slf_fpga_trace.h"
+
 # define DRIVER_NAME "slf_fpga"
 
 static int slf_fpga_major = -1;
@@ -38,57 +54,391 @@ typedef enum {
       ADDR_LEDs      = 0x04,
       ADDR_UserIn    = 0x08,
       ADDR_UserInExp = 0x0c,
-      ADDR_UserInIEN = 0x10
+      ADDR_UserInIEN = 0x10,
+      ADDR_IrqModerate = 0x14,
+      ADDR_CycleCount = 0x18,
+      ADDR_FifoStatus = 0x1c,
+      ADDR_FifoPop    = 0x20,
+      ADDR_CycleCountHi = 0x24,
+      ADDR_IrqStamp   = 0x28,
+      ADDR_IrqStampHi = 0x2c,
+      ADDR_SeqControl = 0x30,
+      ADDR_SeqPeriod  = 0x34,
+      ADDR_SeqLength  = 0x38,
+      ADDR_PwmControl = 0x3c,
+      ADDR_LEDsWide0  = 0x40,
+      ADDR_LEDsWide1  = 0x44,
+      ADDR_DebounceControl = 0x48,
+      ADDR_DebounceTick = 0x4c,
+      ADDR_InterruptStatus = 0x50,
+      ADDR_InterruptEdge = 0x54,
+      ADDR_CycleCountPeek = 0x58,
+      ADDR_IrqStampPeek = 0x5c,
+      ADDR_SeqFrames  = 0x400
 } slf_fpga_addr_t;
 
+# define FIFO_STATUS_LEVEL    0x000001ff
+# define FIFO_STATUS_FLUSH    0x40000000
+# define FIFO_STATUS_OVERFLOW 0x80000000
+# define FIFO_POP_TIME_MASK   0x00ffffff
+# define IRQ_HOLDOFF_MAX      0x003fffff
+# define SEQ_CONTROL_FLAGS    0x00000003
+# define SEQ_CONTROL_FRAME(v) ((v) >> 16)
+# define PWM_CONTROL_WIDE     0x00000001
+# define PWM_CONTROL_GAMMA    0x00000002
+# define DEBOUNCE_FILTER_MAX  0xff
+# define INT_STATUS_CHANGED   0x000000ff
+# define INT_STATUS_USER_IN(v) (((v) >> 8) & 0xff)
+# define INT_STATUS_LEVEL(v)  (((v) >> 16) & 0x1ff)
+# define INT_STATUS_OVERFLOW  0x80000000
+# define INT_EDGE_BOTH        0x0000ffff
+# define INT_EDGE_LATCHED     0x80000000
+# define DEBOUNCE_FAST_SHIFT  16
+
+/*
+ * The frequency of the device clock, which is needed to convert the
+ * change FIFO timestamps to real time. The device tree can set this
+ * per device with a "clock-frequency" property.
+ */
+static unsigned slf_fpga_aclk_hz = 100000000;
+module_param_named(aclk_hz, slf_fpga_aclk_hz, uint, 0444);
+MODULE_PARM_DESC(aclk_hz, "Default device clock frequency (Hz)");
+
+/*
+ * Latency histograms for the interrupt path, for tuning. Bucket n
+ * counts samples in the range [2^n, 2^(n+1)) nanoseconds, except that
+ * bucket 0 also counts 0, and the last bucket counts everything
+ * bigger. The histograms are reported through debugfs.
+ *
+ *   edge_to_isr - From an input change to the ISR handling it. The
+ *                 change FIFO timestamps give the time of the change.
+ *   irq_to_isr  - From the INTERRUPT output asserting to the ISR. The
+ *                 IrqStamp register gives the time of the interrupt.
+ *   isr_to_wake - From the ISR to a thread in SLF_FPGA_WAIT or
+ *                 SLF_FPGA_WAIT2 running again.
+ */
+# define SLF_FPGA_LATENCY_BUCKETS 32
+enum slf_fpga_latency_kind {
+      LATENCY_EDGE_TO_ISR = 0,
+      LATENCY_IRQ_TO_ISR,
+      LATENCY_ISR_TO_WAKE,
+      LATENCY_COUNT
+};
+
+static const char*const slf_fpga_latency_names[LATENCY_COUNT] = {
+      "edge_to_isr",
+      "irq_to_isr",
+      "isr_to_wake"
+};
+
+struct slf_fpga_latency {
+      uint64_t samples;
+      uint64_t total_ns;
+      uint64_t max_ns;
+      uint64_t bucket[SLF_FPGA_LATENCY_BUCKETS];
+};
+
 /*
  * The instance state for a device is represented by an instance of
  * this struct. The probe creates an instance and stashes device state
- * here, and the remove cleans up and deletes the instance.
+ * here, and the remove cleans up and drops the probe's reference to
+ * the instance. Each open file also holds a reference, so the instance
+ * is only deleted when the device is removed and the last file that
+ * uses it is closed.
+ *
+ * Each instance is allocated by the probe, and gets its own minor
+ * number, so there can be many devices. The instance table maps minor
+ * numbers to instances, and is only used by open, probe and remove.
+ * Everything else works with the instance that is bound to the file,
+ * so devices do not share any state once they are open.
  *
  * Also include here some convenience functions that use the device
  * instance to perform basic operations on the hardware, including
  * binding the instance to the opened file, reading/writing registers
  * in the mapped region.
  */
-# define SLF_FPGA_DEVICE_MAX 1
-static struct slf_fpga_instance {
+# define SLF_FPGA_DEVICE_MAX 16
+# define SLF_FPGA_EVENT_RING 256
+struct slf_fpga_instance {
       void __iomem * base;
+      int minor;
+      uint32_t aclk_hz;
+	/* Physical location of the register window, for mmap. */
+      phys_addr_t regs_phys;
+      size_t regs_size;
 
       wait_queue_head_t userin_sync;
+	/* Threads in SLF_FPGA_WAIT2 wait here. Their wait entries
+	   filter the wakeups, so they need their own queue. */
+      wait_queue_head_t wait2_sync;
+
+	/* The lock protects the event ring and the open count, and
+	   serializes register sequences that must be atomic. The ISR
+	   takes it, so other users must disable interrupts. */
+      spinlock_t lock;
+      unsigned open_count;
+	/* The UserInIEN that the driver last wrote. The IRQ line may
+	   be shared, so the ISR only claims the enabled flags. */
+      uint32_t user_in_ien;
+
+	/* The ISR records input changes into this ring. The event_seq
+	   is the total number of events ever recorded, so the slot
+	   for the next event is event_seq % SLF_FPGA_EVENT_RING, and
+	   each open file tracks its own position in the sequence. */
+      uint32_t user_in_last;
+      uint64_t event_seq;
+      struct slf_fpga_event_s event_ring[SLF_FPGA_EVENT_RING];
+	/* Number of times the hardware change FIFO overflowed. */
+      uint32_t fifo_overflows;
+
+	/* Serializes loads of the LED sequencer. A load can take a
+	   while, so this is a mutex and not the spinlock. */
+      struct mutex seq_lock;
 
-} slf_instance_table[SLF_FPGA_DEVICE_MAX] = {
-      { .base = 0 }
+	/* The time of the last ISR that recorded changes, and the
+	   latency histograms. These are also protected by the lock. */
+      uint64_t isr_ns;
+      struct slf_fpga_latency latency[LATENCY_COUNT];
+      struct dentry*debug_dir;
+
+	/* The input snapshot, in its own page so that it can be
+	   mapped by user space. The ISR updates it while holding the
+	   lock, and readers use its seq as a seqlock. If there is no
+	   interrupt, the snapshot is never updated, so the readers
+	   must go to the hardware. */
+      struct page*snapshot_page;
+      struct slf_fpga_snapshot_s*snapshot;
+      bool have_irq;
+      int irq;
+
+	/* The files can outlive the device. The remove sets dead, and
+	   after that the files get -ENODEV. Everything that touches
+	   the hardware for a file holds remove_sem for reading, and
+	   the remove takes it for writing to wait them out, so the
+	   hardware is never touched after the remove. Threads that
+	   sleep while holding it must also wake up on dead. */
+      struct kref ref;
+      struct rw_semaphore remove_sem;
+      bool dead;
 };
 
+static DEFINE_MUTEX(slf_instance_lock);
+static struct slf_fpga_instance*slf_instance_table[SLF_FPGA_DEVICE_MAX];
+
+static void slf_fpga_instance_release(struct kref*ref)
+{
+      struct slf_fpga_instance*xsp = container_of(ref, struct slf_fpga_instance, ref);
+	/* User space mappings of the snapshot hold their own page
+	   references, so the page lasts until they are unmapped. */
+      if (xsp->snapshot_page)
+	    __free_page(xsp->snapshot_page);
+      kfree(xsp);
+}
+
+static void slf_fpga_instance_put(struct slf_fpga_instance*xsp)
+{
+      kref_put(&xsp->ref, slf_fpga_instance_release);
+}
+
+/*
+ * Get the instance for the minor number, with a reference that the
+ * caller must put when it is done. The reference is taken under the
+ * table lock, so that the remove cannot delete the instance first.
+ */
 static struct slf_fpga_instance*select_device(int minor)
 {
       if (minor < 0) return 0;
       if (minor >= SLF_FPGA_DEVICE_MAX) return 0;
-      return slf_instance_table + minor;
+
+      mutex_lock(&slf_instance_lock);
+      struct slf_fpga_instance*xsp = slf_instance_table[minor];
+      if (xsp) kref_get(&xsp->ref);
+      mutex_unlock(&slf_instance_lock);
+      return xsp;
 }
 
-static inline void file_set_private_data(struct file*filp, struct slf_fpga_instance*xsp)
+/*
+ * Bind the instance to the first free minor number. Return the minor
+ * number, or <0 if there are no more.
+ */
+static int slf_fpga_alloc_minor(struct slf_fpga_instance*xsp)
 {
-      filp->private_data = xsp;
+      int minor;
+      mutex_lock(&slf_instance_lock);
+      for (minor = 0 ; minor < SLF_FPGA_DEVICE_MAX ; minor += 1) {
+	    if (slf_instance_table[minor] == 0) {
+		  slf_instance_table[minor] = xsp;
+		  break;
+	    }
+      }
+      mutex_unlock(&slf_instance_lock);
+
+      if (minor >= SLF_FPGA_DEVICE_MAX)
+	    return -ENOSPC;
+
+      xsp->minor = minor;
+      return minor;
 }
 
-static inline struct slf_fpga_instance*file_get_private_data(struct file*filp)
+static void slf_fpga_free_minor(struct slf_fpga_instance*xsp)
 {
-      struct slf_fpga_instance*xsp = (struct slf_fpga_instance*) (filp->private_data);
-      return xsp;
+      mutex_lock(&slf_instance_lock);
+      slf_instance_table[xsp->minor] = 0;
+      mutex_unlock(&slf_instance_lock);
+}
+
+/*
+ * Each open file gets one of these. It binds the file to the device
+ * instance, and holds the position of the file in the event stream.
+ */
+struct slf_fpga_file {
+      struct slf_fpga_instance*xsp;
+
+      uint64_t event_next;
+      uint32_t events_dropped;
+};
+
+static inline void file_set_private_data(struct file*filp, struct slf_fpga_file*fsp)
+{
+      filp->private_data = fsp;
+}
+
+static inline struct slf_fpga_file*file_get_file_state(struct file*filp)
+{
+      struct slf_fpga_file*fsp = (struct slf_fpga_file*) (filp->private_data);
+      return fsp;
 }
 
-inline uint32_t slf_fpga_read32(struct slf_fpga_instance*xsp, slf_fpga_addr_t offset)
+/*
+ * The register accessors time each access for the slf_fpga_mmio
+ * tracepoint, but only when it is enabled.
+ */
+static inline uint32_t slf_fpga_read32(struct slf_fpga_instance*xsp, slf_fpga_addr_t offset)
 {
       void __iomem*addr = xsp->base + offset;
-      return ioread32(addr);
+      if (! trace_slf_fpga_mmio_enabled())
+	    return ioread32(addr);
+
+      uint64_t start_ns = ktime_get_ns();
+      uint32_t val = ioread32(addr);
+      trace_slf_fpga_mmio(xsp->minor, offset, val, false, ktime_get_ns() - start_ns);
+      return val;
 }
 
-inline void slf_fpga_write32(struct slf_fpga_instance*xsp, slf_fpga_addr_t offset, uint32_t val)
+static inline void slf_fpga_write32(struct slf_fpga_instance*xsp, slf_fpga_addr_t offset, uint32_t val)
 {
       void __iomem*addr = xsp->base + offset;
+      if (! trace_slf_fpga_mmio_enabled()) {
+	    iowrite32(val, addr);
+	    return;
+      }
+
+      uint64_t start_ns = ktime_get_ns();
       iowrite32(val, addr);
+      trace_slf_fpga_mmio(xsp->minor, offset, val, true, ktime_get_ns() - start_ns);
+}
+
+/*
+ * Convert a count of device clocks to nanoseconds.
+ */
+static uint64_t slf_fpga_clocks_to_ns(struct slf_fpga_instance*xsp, uint32_t clocks)
+{
+      return div_u64((uint64_t)clocks * NSEC_PER_SEC, xsp->aclk_hz);
+}
+
+/*
+ * Add a sample to a latency histogram. The caller must hold the
+ * instance lock.
+ */
+static void slf_fpga_latency_record(struct slf_fpga_instance*xsp,
+				    enum slf_fpga_latency_kind kind, uint64_t ns)
+{
+      struct slf_fpga_latency*lp = xsp->latency + kind;
+      unsigned idx = ns == 0? 0 : ilog2(ns);
+      if (idx >= SLF_FPGA_LATENCY_BUCKETS)
+	    idx = SLF_FPGA_LATENCY_BUCKETS-1;
+
+      lp->bucket[idx] += 1;
+      lp->samples += 1;
+      lp->total_ns += ns;
+      if (ns > lp->max_ns)
+	    lp->max_ns = ns;
+}
+
+/*
+ * A waiting thread calls this when it wakes up and finds that the
+ * change it was waiting for has happened.
+ */
+static void slf_fpga_latency_wake(struct slf_fpga_instance*xsp)
+{
+      unsigned long flags;
+      uint64_t now_ns = ktime_get_ns();
+      spin_lock_irqsave(&xsp->lock, flags);
+      slf_fpga_latency_record(xsp, LATENCY_ISR_TO_WAKE, now_ns - xsp->isr_ns);
+      spin_unlock_irqrestore(&xsp->lock, flags);
+}
+
+/*
+ * Discard whatever is in the change FIFO. The FIFO collects changes
+ * even while nobody is listening, and those are stale. The flush is
+ * a single register write, so it is cheap enough to do while holding
+ * the lock.
+ */
+static void slf_fpga_fifo_flush(struct slf_fpga_instance*xsp)
+{
+      slf_fpga_write32(xsp, ADDR_FifoStatus, FIFO_STATUS_FLUSH|FIFO_STATUS_OVERFLOW);
+}
+
+/*
+ * The snapshot is shared with user space, so its sequence counter is
+ * a plain u32 at a known place instead of a seqcount_t. The writer
+ * must hold the instance lock.
+ */
+static void slf_fpga_snapshot_write_begin(struct slf_fpga_snapshot_s*snap)
+{
+      WRITE_ONCE(snap->seq, snap->seq + 1);
+      smp_wmb();
+}
+
+static void slf_fpga_snapshot_write_end(struct slf_fpga_snapshot_s*snap)
+{
+      smp_wmb();
+      WRITE_ONCE(snap->seq, snap->seq + 1);
+}
+
+static void slf_fpga_snapshot_read(struct slf_fpga_instance*xsp,
+				   struct slf_fpga_snapshot_s*val)
+{
+      const struct slf_fpga_snapshot_s*snap = xsp->snapshot;
+      uint32_t seq;
+      do {
+	    seq = READ_ONCE(snap->seq);
+	    smp_rmb();
+	    *val = *snap;
+	    smp_rmb();
+      } while ((seq & 1) || seq != READ_ONCE(snap->seq));
+      val->seq = seq;
+}
+
+/*
+ * The last user input value seen by the ISR. While the device is
+ * open, this is kept up to date, and it is read from the snapshot
+ * without taking the lock or touching the hardware.
+ */
+static uint32_t slf_fpga_user_in_current(struct slf_fpga_instance*xsp)
+{
+      if (! xsp->have_irq)
+	    return slf_fpga_read32(xsp, ADDR_UserIn);
+
+      const struct slf_fpga_snapshot_s*snap = xsp->snapshot;
+      uint32_t seq, value;
+      do {
+	    seq = READ_ONCE(snap->seq);
+	    smp_rmb();
+	    value = READ_ONCE(snap->user_in);
+	    smp_rmb();
+      } while ((seq & 1) || seq != READ_ONCE(snap->seq));
+      return value;
 }
 
 /*
@@ -97,9 +447,51 @@ inline void slf_fpga_write32(struct slf_fpga_instance*xsp, slf_fpga_addr_t offse
  */
 static int slf_fpga_open(struct inode*inode, struct file*filp)
 {
+      unsigned long flags;
       struct slf_fpga_instance*xsp = select_device(MINOR(inode->i_rdev));
       if (xsp == 0) return -ENODEV;
-      file_set_private_data(filp, xsp);
+
+      struct slf_fpga_file*fsp = kzalloc(sizeof(struct slf_fpga_file), GFP_KERNEL);
+      if (fsp == 0) {
+	    slf_fpga_instance_put(xsp);
+	    return -ENOMEM;
+      }
+      fsp->xsp = xsp;
+
+      down_read(&xsp->remove_sem);
+      if (xsp->dead) {
+	    up_read(&xsp->remove_sem);
+	    kfree(fsp);
+	    slf_fpga_instance_put(xsp);
+	    return -ENODEV;
+      }
+
+      spin_lock_irqsave(&xsp->lock, flags);
+
+	/* The first open turns on the input interrupts, so that the
+	   ISR can start recording events. Put the hardware in Latched
+	   mode with both edges enabled, and clear any stale change
+	   flags, so that we only record changes after the open. */
+      if (xsp->open_count == 0) {
+	    slf_fpga_fifo_flush(xsp);
+	    xsp->user_in_last = slf_fpga_read32(xsp, ADDR_UserIn);
+	    slf_fpga_snapshot_write_begin(xsp->snapshot);
+	    xsp->snapshot->user_in = xsp->user_in_last;
+	    slf_fpga_snapshot_write_end(xsp->snapshot);
+	    slf_fpga_write32(xsp, ADDR_InterruptEdge, INT_EDGE_LATCHED|INT_EDGE_BOTH);
+	    slf_fpga_write32(xsp, ADDR_InterruptStatus, INT_STATUS_CHANGED);
+	    WRITE_ONCE(xsp->user_in_ien, 0xff);
+	    slf_fpga_write32(xsp, ADDR_UserInIEN, 0xff);
+      }
+      xsp->open_count += 1;
+
+	/* New files only see events that happen after the open. */
+      fsp->event_next = xsp->event_seq;
+
+      spin_unlock_irqrestore(&xsp->lock, flags);
+      up_read(&xsp->remove_sem);
+
+      file_set_private_data(filp, fsp);
       return 0;
 }
 
@@ -109,35 +501,203 @@ static int slf_fpga_open(struct inode*inode, struct file*filp)
  */
 static int slf_fpga_release(struct inode*inodep, struct file*filp)
 {
-      struct slf_fpga_instance*xsp = file_get_private_data(filp);
+      unsigned long flags;
+      struct slf_fpga_file*fsp = file_get_file_state(filp);
+      struct slf_fpga_instance*xsp = fsp->xsp;
+
+      down_read(&xsp->remove_sem);
+      spin_lock_irqsave(&xsp->lock, flags);
+
+	/* Make sure interrupts are off when the last file closes, and
+	   take the hardware out of Latched mode, so that flags do not
+	   collect while nobody is listening. If the device is gone,
+	   the remove already did that. */
+      xsp->open_count -= 1;
+      if (xsp->open_count == 0 && ! xsp->dead) {
+	    WRITE_ONCE(xsp->user_in_ien, 0x00);
+	    slf_fpga_write32(xsp, ADDR_UserInIEN, 0x00);
+	    slf_fpga_write32(xsp, ADDR_InterruptEdge, INT_EDGE_BOTH);
+	    slf_fpga_write32(xsp, ADDR_InterruptStatus, INT_STATUS_CHANGED);
+      }
 
-	/* Make sure interrupts are off. */
-      slf_fpga_write32(xsp, ADDR_UserInIEN, 0x00);
+      spin_unlock_irqrestore(&xsp->lock, flags);
+      up_read(&xsp->remove_sem);
 
       file_set_private_data(filp, 0);
+      kfree(fsp);
+      slf_fpga_instance_put(xsp);
       return 0;
 }
 
+/*
+ * Bring the file position in the event ring up to date. If the file
+ * has fallen more than a full ring behind, then the oldest events
+ * have been overwritten. Skip past them and count them as dropped.
+ * The caller must hold the instance lock.
+ */
+static uint64_t slf_fpga_events_pending(struct slf_fpga_file*fsp)
+{
+      struct slf_fpga_instance*xsp = fsp->xsp;
+      uint64_t pending = xsp->event_seq - fsp->event_next;
+      if (pending > SLF_FPGA_EVENT_RING) {
+	    fsp->events_dropped += pending - SLF_FPGA_EVENT_RING;
+	    fsp->event_next = xsp->event_seq - SLF_FPGA_EVENT_RING;
+	    pending = SLF_FPGA_EVENT_RING;
+      }
+      return pending;
+}
+
+static bool slf_fpga_events_ready(struct slf_fpga_file*fsp)
+{
+      unsigned long flags;
+      struct slf_fpga_instance*xsp = fsp->xsp;
+      spin_lock_irqsave(&xsp->lock, flags);
+      uint64_t pending = slf_fpga_events_pending(fsp);
+      spin_unlock_irqrestore(&xsp->lock, flags);
+      return pending != 0;
+}
+
+/*
+ * The read returns whole struct slf_fpga_event_s records, as many as
+ * are available and fit in the buffer. Block until there is at least
+ * one event, unless the file is non-blocking.
+ */
+# define SLF_FPGA_READ_CHUNK 16
+static ssize_t slf_fpga_read(struct file*filp, char __user*buf, size_t count, loff_t*off)
+{
+      unsigned long flags;
+      struct slf_fpga_file*fsp = file_get_file_state(filp);
+      struct slf_fpga_instance*xsp = fsp->xsp;
+      size_t want = count / sizeof(struct slf_fpga_event_s);
+      if (want == 0)
+	    return -EINVAL;
+
+      if (! slf_fpga_events_ready(fsp)) {
+	    if (READ_ONCE(xsp->dead))
+		  return -ENODEV;
+	    if (filp->f_flags & O_NONBLOCK)
+		  return -EAGAIN;
+
+	    trace_slf_fpga_wait_enter(xsp->minor, 0, 0, 0);
+	    int rc = wait_event_interruptible(xsp->userin_sync, slf_fpga_events_ready(fsp)
+					      || READ_ONCE(xsp->dead));
+	    trace_slf_fpga_wait_exit(xsp->minor, 0, rc, xsp->user_in_last);
+	    if (rc < 0)
+		  return rc;
+	    if (! slf_fpga_events_ready(fsp))
+		  return -ENODEV;
+      }
+
+	/* Copy the events out in chunks. The ring can only be
+	   touched while holding the lock, and we can't copy to user
+	   space while holding the lock, so stage the events here. */
+      struct slf_fpga_event_s chunk[SLF_FPGA_READ_CHUNK];
+      size_t done = 0;
+      while (done < want) {
+	    size_t cnt = 0;
+	    spin_lock_irqsave(&xsp->lock, flags);
+	    uint64_t pending = slf_fpga_events_pending(fsp);
+	    while (cnt < pending && cnt < SLF_FPGA_READ_CHUNK && done+cnt < want) {
+		  unsigned idx = fsp->event_next & (SLF_FPGA_EVENT_RING-1);
+		  chunk[cnt] = xsp->event_ring[idx];
+		  fsp->event_next += 1;
+		  cnt += 1;
+	    }
+	    spin_unlock_irqrestore(&xsp->lock, flags);
+
+	    if (cnt == 0)
+		  break;
+
+	    if (copy_to_user(buf + done*sizeof(struct slf_fpga_event_s), chunk,
+			     cnt * sizeof(struct slf_fpga_event_s)) != 0)
+		  return done? done * sizeof(struct slf_fpga_event_s) : -EFAULT;
+
+	    done += cnt;
+      }
+
+      return done * sizeof(struct slf_fpga_event_s);
+}
+
+/*
+ * Write the LEDs register. This also switches the LEDs back from the
+ * wide levels, but keeps the gamma setting, so that the write takes
+ * effect. The caller must hold the instance lock.
+ */
+static void slf_fpga_leds_write(struct slf_fpga_instance*xsp, uint32_t val)
+{
+      slf_fpga_write32(xsp, ADDR_LEDs, val);
+      uint32_t pwm = slf_fpga_read32(xsp, ADDR_PwmControl);
+      if (pwm & PWM_CONTROL_WIDE)
+	    slf_fpga_write32(xsp, ADDR_PwmControl, pwm & ~PWM_CONTROL_WIDE);
+}
+
 /*
  * Write to the leds register.
  */
 static long slf_fpga_leds_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
 {
+      unsigned long flags;
       struct slf_fpga_leds_s arg;
       if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
 	    return -EFAULT;
 
-      slf_fpga_write32(xsp, ADDR_LEDs, arg.led_value);
+	/* Take the lock so that this does not land in the middle of
+	   a batch that is modifying the LEDs. */
+      spin_lock_irqsave(&xsp->lock, flags);
+      slf_fpga_leds_write(xsp, arg.led_value);
+      spin_unlock_irqrestore(&xsp->lock, flags);
+      return 0;
+}
+
+static long slf_fpga_leds_wide_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      unsigned long flags;
+      struct slf_fpga_leds_wide_s arg;
+      if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
+	    return -EFAULT;
+
+      if (arg.flags & ~SLF_FPGA_LED_GAMMA)
+	    return -EINVAL;
+      if (arg.reserved != 0)
+	    return -EINVAL;
+
+      uint32_t wide0 = arg.level[0] | (arg.level[1] << 8)
+	    | (arg.level[2] << 16) | ((uint32_t)arg.level[3] << 24);
+      uint32_t wide1 = arg.level[4] | (arg.level[5] << 8)
+	    | (arg.level[6] << 16) | ((uint32_t)arg.level[7] << 24);
+      uint32_t pwm = PWM_CONTROL_WIDE;
+      if (arg.flags & SLF_FPGA_LED_GAMMA)
+	    pwm |= PWM_CONTROL_GAMMA;
+
+      spin_lock_irqsave(&xsp->lock, flags);
+      slf_fpga_write32(xsp, ADDR_LEDsWide0, wide0);
+      slf_fpga_write32(xsp, ADDR_LEDsWide1, wide1);
+      slf_fpga_write32(xsp, ADDR_PwmControl, pwm);
+      spin_unlock_irqrestore(&xsp->lock, flags);
       return 0;
 }
 
 /*
- * Read from the UserIn (buttons) register.
+ * Get the value of the UserIn (buttons) register. The ISR keeps the
+ * snapshot up to date, so this doesn't need to read the hardware.
  */
 static long slf_fpga_userin_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
 {
       struct slf_fpga_UserIn_s arg;
-      arg.user_in_value = slf_fpga_read32(xsp, ADDR_UserIn);
+      arg.user_in_value = slf_fpga_user_in_current(xsp);
+      if (copy_to_user((void __user*)raw, &arg, sizeof arg) != 0)
+	    return -EFAULT;
+
+      return 0;
+}
+
+static long slf_fpga_snapshot_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      struct slf_fpga_snapshot_s arg;
+      slf_fpga_snapshot_read(xsp, &arg);
+      if (! xsp->have_irq)
+	    arg.user_in = slf_fpga_read32(xsp, ADDR_UserIn);
+
       if (copy_to_user((void __user*)raw, &arg, sizeof arg) != 0)
 	    return -EFAULT;
 
@@ -147,19 +707,20 @@ static long slf_fpga_userin_ioctl(struct slf_fpga_instance*xsp, unsigned long ra
 static long slf_fpga_wait_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
 {
       long rc = 0;
+      bool slept = false;
       struct slf_fpga_wait_s arg;
       if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
 	    return -EFAULT;
 
-	/* Make sure interrupts are enabled.
-	   NOTE 1: Currently, the hardware only has 8 buttons.
-	   NOTE 2: The interrupts will be cleared on release, so we
-	   don't need to turn them off again here. In fact, turning
-	   interrupts off here may mess with parallel threads. */
-      slf_fpga_write32(xsp, ADDR_UserInIEN, 0xff);
+	/* NOTE: The interrupts are enabled by the open, and will be
+	   cleared by the release of the last file, so we don't need
+	   to touch them here. In fact, turning interrupts on and off
+	   here may mess with parallel threads. */
 
 	/* Wait for the input value to be different from the
 	   expected value. */
+      trace_slf_fpga_wait_enter(xsp->minor, SLF_FPGA_WAIT, arg.user_in_exp, 0xffffffff);
+
       struct wait_queue_entry wait_cell;
       init_waitqueue_entry(&wait_cell, current);
       add_wait_queue(&xsp->userin_sync, &wait_cell);
@@ -170,22 +731,33 @@ static long slf_fpga_wait_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
 	      /* Get the current input value. If it differs from the
 		 expected value, then we are done, break out of the
 		 wait loop. */
-	    arg.user_in_value = slf_fpga_read32(xsp, ADDR_UserIn);
+	    arg.user_in_value = slf_fpga_user_in_current(xsp);
 	    if (arg.user_in_value != arg.user_in_exp)
 		  break;
 
+	    rc = -ENODEV;
+	    if (READ_ONCE(xsp->dead))
+		  break;
+
 	    rc = -ERESTART;
 	    if (signal_pending(current))
 		break;
 
 	    schedule();
+	    slept = true;
+	    trace_slf_fpga_wait_wake(xsp->minor, SLF_FPGA_WAIT);
       }
       set_current_state(TASK_RUNNING);
       remove_wait_queue(&xsp->userin_sync, &wait_cell);
 
+      trace_slf_fpga_wait_exit(xsp->minor, SLF_FPGA_WAIT, rc, arg.user_in_value);
+
       if (rc < 0)
 	    return rc;
 
+      if (slept)
+	    slf_fpga_latency_wake(xsp);
+
 	/* Send the results back to the user. */
       if (copy_to_user((void __user*)raw, &arg, sizeof arg) != 0)
 	    return -EFAULT;
@@ -193,25 +765,596 @@ static long slf_fpga_wait_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
       return 0;
 }
 
+/*
+ * The device is readable when there are events that this file has not
+ * yet read. The file position in the event stream is the "last seen"
+ * state, so each file that polls is woken for every change, and stays
+ * readable until it reads the events.
+ */
+static __poll_t slf_fpga_poll(struct file*filp, poll_table*wait)
+{
+      struct slf_fpga_file*fsp = file_get_file_state(filp);
+      struct slf_fpga_instance*xsp = fsp->xsp;
+      __poll_t mask = 0;
+
+      poll_wait(filp, &xsp->userin_sync, wait);
+
+      if (slf_fpga_events_ready(fsp))
+	    mask |= EPOLLIN | EPOLLRDNORM;
+      if (READ_ONCE(xsp->dead))
+	    mask |= EPOLLHUP | EPOLLERR;
+
+      return mask;
+}
+
+/*
+ * Map the register window into the user's address space. The
+ * registers are uncached device memory, and all of them share a
+ * single page, so the protection can only be set for the window as a
+ * whole. Open the device O_RDONLY to get a read-only mapping. Writes
+ * to the read-only registers (BUILD_ID, UserIn) are ignored by the
+ * hardware anyhow.
+ *
+ * The input snapshot is mapped instead at SLF_FPGA_MMAP_SNAPSHOT. It
+ * is ordinary memory, and is always read-only.
+ */
+static int slf_fpga_mmap(struct file*filp, struct vm_area_struct*vma)
+{
+      struct slf_fpga_file*fsp = file_get_file_state(filp);
+      struct slf_fpga_instance*xsp = fsp->xsp;
+
+      if (READ_ONCE(xsp->dead))
+	    return -ENODEV;
+
+      if (vma->vm_pgoff == (SLF_FPGA_MMAP_SNAPSHOT >> PAGE_SHIFT)) {
+	    if (vma->vm_end - vma->vm_start > PAGE_SIZE)
+		  return -EINVAL;
+	    if (vma->vm_flags & VM_WRITE)
+		  return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+	    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+	    return vm_insert_page(vma, vma->vm_start, xsp->snapshot_page);
+      }
+
+      if (xsp->regs_size == 0)
+	    return -ENODEV;
+
+      vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+      return vm_iomap_memory(vma, xsp->regs_phys, xsp->regs_size);
+}
+
+/*
+ * Check that a batch entry is an operation we know, on a register
+ * that exists. Writes to the read-only registers are refused, and so
+ * are writes to the interrupt registers and FifoStatus, which the
+ * driver owns from the first open. The event ring and the waiters
+ * depend on them, and the interrupt handler pops as many FIFO entries
+ * as the level it read, so a flush in between would have it record
+ * empty pops as events.
+ */
+static bool slf_fpga_batch_op_valid(const struct slf_fpga_batch_op_s*op)
+{
+      bool writable;
+      switch (op->address) {
+	  case ADDR_BUILD_ID:
+	  case ADDR_UserIn:
+	  case ADDR_CycleCount:
+	  case ADDR_CycleCountHi:
+	  case ADDR_IrqStamp:
+	  case ADDR_IrqStampHi:
+	  case ADDR_DebounceTick:
+	  case ADDR_CycleCountPeek:
+	  case ADDR_IrqStampPeek:
+	  case ADDR_UserInExp:
+	  case ADDR_UserInIEN:
+	  case ADDR_IrqModerate:
+	  case ADDR_InterruptStatus:
+	  case ADDR_InterruptEdge:
+	  case ADDR_FifoStatus:
+	    writable = false;
+	    break;
+	  case ADDR_LEDs:
+	  case ADDR_SeqControl:
+	  case ADDR_SeqPeriod:
+	  case ADDR_SeqLength:
+	  case ADDR_PwmControl:
+	  case ADDR_LEDsWide0:
+	  case ADDR_LEDsWide1:
+	  case ADDR_DebounceControl:
+	    writable = true;
+	    break;
+	  default:
+	    return false;
+      }
+
+      switch (op->op) {
+	  case SLF_FPGA_BATCH_READ:   return true;
+	  case SLF_FPGA_BATCH_WRITE:  return writable;
+	  case SLF_FPGA_BATCH_MODIFY: return writable;
+	  default:                    return false;
+      }
+}
+
+static long slf_fpga_batch_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      unsigned long flags;
+      struct slf_fpga_batch_s arg;
+      if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
+	    return -EFAULT;
+
+      if (arg.count == 0)
+	    return 0;
+      if (arg.count > SLF_FPGA_BATCH_MAX)
+	    return -EINVAL;
+
+      void __user*uops = (void __user*)(uintptr_t)arg.ops;
+      size_t ops_size = arg.count * sizeof(struct slf_fpga_batch_op_s);
+      struct slf_fpga_batch_op_s*ops = memdup_user(uops, ops_size);
+      if (IS_ERR(ops))
+	    return PTR_ERR(ops);
+
+      long rc = 0;
+      unsigned idx;
+      for (idx = 0 ; idx < arg.count ; idx += 1) {
+	    if (! slf_fpga_batch_op_valid(ops+idx)) {
+		  rc = -EINVAL;
+		  goto out;
+	    }
+      }
+
+	/* Run the whole sequence under the lock, with no user
+	   memory access, so that it is atomic. */
+      spin_lock_irqsave(&xsp->lock, flags);
+      for (idx = 0 ; idx < arg.count ; idx += 1) {
+	    struct slf_fpga_batch_op_s*op = ops + idx;
+	    uint32_t val;
+	    switch (op->op) {
+		case SLF_FPGA_BATCH_READ:
+		  op->value = slf_fpga_read32(xsp, op->address) & op->mask;
+		  break;
+		case SLF_FPGA_BATCH_WRITE:
+		  if (op->address == ADDR_LEDs)
+			slf_fpga_leds_write(xsp, op->value);
+		  else
+			slf_fpga_write32(xsp, op->address, op->value);
+		  break;
+		case SLF_FPGA_BATCH_MODIFY:
+		  val = slf_fpga_read32(xsp, op->address);
+		  if (op->address == ADDR_LEDs)
+			slf_fpga_leds_write(xsp, (val & ~op->mask) | (op->value & op->mask));
+		  else
+			slf_fpga_write32(xsp, op->address, (val & ~op->mask) | (op->value & op->mask));
+		  op->value = val;
+		  break;
+	    }
+      }
+      spin_unlock_irqrestore(&xsp->lock, flags);
+
+      if (copy_to_user(uops, ops, ops_size) != 0)
+	    rc = -EFAULT;
+
+ out:
+      kfree(ops);
+      return rc;
+}
+
+/*
+ * The debounce filter in the device counts in ticks, so convert the
+ * time to ticks, rounding up, and return the time that is actually
+ * in effect.
+ */
+static long slf_fpga_debounce_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      struct slf_fpga_debounce_s arg;
+      if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
+	    return -EFAULT;
+
+      if (arg.fast_mask & ~0xffU)
+	    return -EINVAL;
+
+      uint32_t tick_clocks = slf_fpga_read32(xsp, ADDR_DebounceTick);
+      uint64_t tick_ns = slf_fpga_clocks_to_ns(xsp, tick_clocks);
+      if (tick_ns == 0)
+	    tick_ns = 1;
+
+      uint64_t ticks = div64_u64(arg.filter_ns + tick_ns - 1, tick_ns);
+      if (ticks > DEBOUNCE_FILTER_MAX)
+	    return -EINVAL;
+
+      slf_fpga_write32(xsp, ADDR_DebounceControl,
+		       (arg.fast_mask << DEBOUNCE_FAST_SHIFT) | (uint32_t)ticks);
+
+      arg.filter_ns = ticks * tick_ns;
+      if (copy_to_user((void __user*)raw, &arg, sizeof arg) != 0)
+	    return -EFAULT;
+
+      return 0;
+}
+
+/*
+ * Configure the interrupt moderation register. The change FIFO
+ * timestamps are only 24 bits, so the ISR can only date entries that
+ * are less than 2^24 clocks old. Limit the holdoff to a quarter of
+ * that, to leave the rest for the interrupt latency.
+ */
+static long slf_fpga_irq_moderate_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      struct slf_fpga_irq_moderate_s arg;
+      if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
+	    return -EFAULT;
+
+      if (arg.holdoff_clocks > IRQ_HOLDOFF_MAX)
+	    return -EINVAL;
+      if (arg.event_count > 0xff)
+	    return -EINVAL;
+
+      slf_fpga_write32(xsp, ADDR_IrqModerate, (arg.event_count << 24) | arg.holdoff_clocks);
+      return 0;
+}
+
+/*
+ * Load the LED sequencer. Stop the sequencer, then write all the frames
+ * into the frame memory with one bulk copy.
+ */
+static long slf_fpga_seq_load_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      struct slf_fpga_seq_load_s arg;
+      if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
+	    return -EFAULT;
+
+      if (arg.count == 0 || arg.count > SLF_FPGA_SEQ_FRAMES)
+	    return -EINVAL;
+      if (arg.period_clocks == 0)
+	    return -EINVAL;
+      if (arg.flags & ~SEQ_CONTROL_FLAGS)
+	    return -EINVAL;
+
+      void __user*uframes = (void __user*)(uintptr_t)arg.frames;
+      uint32_t*frames = memdup_user(uframes, arg.count * sizeof(uint32_t));
+      if (IS_ERR(frames))
+	    return PTR_ERR(frames);
+
+      mutex_lock(&xsp->seq_lock);
+      slf_fpga_write32(xsp, ADDR_SeqControl, 0);
+      __iowrite32_copy(xsp->base + ADDR_SeqFrames, frames, arg.count);
+      slf_fpga_write32(xsp, ADDR_SeqLength, arg.count);
+      slf_fpga_write32(xsp, ADDR_SeqPeriod, arg.period_clocks - 1);
+      slf_fpga_write32(xsp, ADDR_SeqControl, arg.flags);
+      mutex_unlock(&xsp->seq_lock);
+
+      kfree(frames);
+      return 0;
+}
+
+static long slf_fpga_seq_control_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      struct slf_fpga_seq_control_s arg;
+      if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
+	    return -EFAULT;
+
+      if (arg.flags & ~SEQ_CONTROL_FLAGS)
+	    return -EINVAL;
+
+      mutex_lock(&xsp->seq_lock);
+      uint32_t val = slf_fpga_read32(xsp, ADDR_SeqControl);
+	/* Stop first, so that the run restarts from the first frame. */
+      if (arg.flags & SLF_FPGA_SEQ_RUN)
+	    slf_fpga_write32(xsp, ADDR_SeqControl, 0);
+      slf_fpga_write32(xsp, ADDR_SeqControl, arg.flags);
+      mutex_unlock(&xsp->seq_lock);
+
+      arg.flags = val & SEQ_CONTROL_FLAGS;
+      arg.frame = SEQ_CONTROL_FRAME(val);
+      if (copy_to_user((void __user*)raw, &arg, sizeof arg) != 0)
+	    return -EFAULT;
+
+      return 0;
+}
+
+/*
+ * Report the state of the event stream for this file.
+ */
+static long slf_fpga_event_stats_ioctl(struct slf_fpga_file*fsp, unsigned long raw)
+{
+      unsigned long flags;
+      struct slf_fpga_instance*xsp = fsp->xsp;
+      struct slf_fpga_event_stats_s arg;
+
+      spin_lock_irqsave(&xsp->lock, flags);
+      arg.events_pending = slf_fpga_events_pending(fsp);
+      arg.events_dropped = fsp->events_dropped;
+      arg.fifo_overflows = xsp->fifo_overflows;
+      spin_unlock_irqrestore(&xsp->lock, flags);
+
+      if (copy_to_user((void __user*)raw, &arg, sizeof arg) != 0)
+	    return -EFAULT;
+
+      return 0;
+}
+
+/*
+ * Return the bits of the user input value that differ from the
+ * expected value in the way that the edges select.
+ */
+static uint32_t slf_fpga_edges_match(uint32_t value, uint32_t exp,
+				     uint32_t mask, uint32_t edges)
+{
+      uint32_t diff = (value ^ exp) & mask;
+      uint32_t match = 0;
+      if (edges & SLF_FPGA_EDGE_RISING)  match |= diff & value;
+      if (edges & SLF_FPGA_EDGE_FALLING) match |= diff & ~value;
+      return match;
+}
+
+/*
+ * This is the wait queue entry for a thread in SLF_FPGA_WAIT2. The
+ * wake function checks the change that the ISR passes as the key, and
+ * only wakes the thread if the change touches the bits it is waiting
+ * for, in the direction it is waiting for.
+ */
+struct slf_fpga_waiter {
+      struct wait_queue_entry wait;
+      uint32_t mask;
+      uint32_t edges;
+};
+
+static int slf_fpga_wait2_wake(struct wait_queue_entry*wait, unsigned mode,
+			       int sync, void*key)
+{
+      struct slf_fpga_waiter*wp = container_of(wait, struct slf_fpga_waiter, wait);
+      const struct slf_fpga_event_s*evp = (const struct slf_fpga_event_s*)key;
+
+      if (evp && slf_fpga_edges_match(evp->user_in_new, evp->user_in_old,
+				      wp->mask, wp->edges) == 0)
+	    return 0;
+
+      return default_wake_function(wait, mode, sync, key);
+}
+
+static long slf_fpga_wait2_ioctl(struct slf_fpga_instance*xsp, unsigned long raw)
+{
+      long rc = 0;
+      bool slept = false;
+      struct slf_fpga_wait2_s arg;
+      if (copy_from_user(&arg, (void __user*)raw, sizeof arg) != 0)
+	    return -EFAULT;
+
+      if (arg.edges == 0)
+	    arg.edges = SLF_FPGA_EDGE_BOTH;
+
+      struct slf_fpga_waiter waiter;
+      init_waitqueue_func_entry(&waiter.wait, slf_fpga_wait2_wake);
+      waiter.wait.private = current;
+      waiter.mask  = arg.mask;
+      waiter.edges = arg.edges;
+
+	/* The timeout is an absolute time, so that spurious wakeups
+	   don't stretch it out. */
+      ktime_t expires = ktime_add_ms(ktime_get(), arg.timeout_ms);
+
+	/* The ISR keeps user_in_last up to date while the device is
+	   open, so there is no need to read the hardware here. */
+      trace_slf_fpga_wait_enter(xsp->minor, SLF_FPGA_WAIT2, arg.user_in_exp, arg.mask);
+      add_wait_queue(&xsp->wait2_sync, &waiter.wait);
+      for (;;) {
+	    set_current_state(TASK_INTERRUPTIBLE);
+
+	    arg.user_in_value = slf_fpga_user_in_current(xsp);
+	    if (slf_fpga_edges_match(arg.user_in_value, arg.user_in_exp,
+				     arg.mask, arg.edges) != 0) {
+		  rc = 0;
+		  break;
+	    }
+
+	    if (READ_ONCE(xsp->dead)) {
+		  rc = -ENODEV;
+		  break;
+	    }
+
+	    if (signal_pending(current)) {
+		  rc = -ERESTARTSYS;
+		  break;
+	    }
+
+	    if (arg.timeout_ms == 0) {
+		  schedule();
+	    } else if (schedule_hrtimeout(&expires, HRTIMER_MODE_ABS) == 0) {
+		  rc = -ETIMEDOUT;
+		  break;
+	    }
+	    slept = true;
+	    trace_slf_fpga_wait_wake(xsp->minor, SLF_FPGA_WAIT2);
+      }
+      set_current_state(TASK_RUNNING);
+      remove_wait_queue(&xsp->wait2_sync, &waiter.wait);
+
+      trace_slf_fpga_wait_exit(xsp->minor, SLF_FPGA_WAIT2, rc, arg.user_in_value);
+
+      if (rc == -ERESTARTSYS || rc == -ENODEV)
+	    return rc;
+
+      if (rc == 0 && slept)
+	    slf_fpga_latency_wake(xsp);
+
+	/* Send the results back to the user, even for a timeout. */
+      if (copy_to_user((void __user*)raw, &arg, sizeof arg) != 0)
+	    return -EFAULT;
+
+      return rc;
+}
+
 static long slf_fpga_ioctl(struct file*filp, unsigned int cmd, unsigned long raw)
 {
-      struct slf_fpga_instance*xsp = file_get_private_data(filp);
+      struct slf_fpga_file*fsp = file_get_file_state(filp);
+      struct slf_fpga_instance*xsp = fsp->xsp;
+      long rc;
+
+      trace_slf_fpga_ioctl_enter(xsp->minor, cmd);
+      down_read(&xsp->remove_sem);
+      if (xsp->dead) {
+	    rc = -ENODEV;
+	    goto out;
+      }
+
       switch (cmd) {
-	  case SLF_FPGA_LEDS:   return slf_fpga_leds_ioctl(xsp, raw);
-	  case SLF_FPGA_UserIn: return slf_fpga_userin_ioctl(xsp, raw);
-	  case SLF_FPGA_WAIT:   return slf_fpga_wait_ioctl(xsp, raw);
-	  default:              return -ENOTTY;
+	  case SLF_FPGA_LEDS:   rc = slf_fpga_leds_ioctl(xsp, raw); break;
+	  case SLF_FPGA_UserIn: rc = slf_fpga_userin_ioctl(xsp, raw); break;
+	  case SLF_FPGA_WAIT:   rc = slf_fpga_wait_ioctl(xsp, raw); break;
+	  case SLF_FPGA_EVENT_STATS: rc = slf_fpga_event_stats_ioctl(fsp, raw); break;
+	  case SLF_FPGA_BATCH:  rc = slf_fpga_batch_ioctl(xsp, raw); break;
+	  case SLF_FPGA_WAIT2:  rc = slf_fpga_wait2_ioctl(xsp, raw); break;
+	  case SLF_FPGA_IRQ_MODERATE: rc = slf_fpga_irq_moderate_ioctl(xsp, raw); break;
+	  case SLF_FPGA_SEQ_LOAD: rc = slf_fpga_seq_load_ioctl(xsp, raw); break;
+	  case SLF_FPGA_SEQ_CONTROL: rc = slf_fpga_seq_control_ioctl(xsp, raw); break;
+	  case SLF_FPGA_LEDS_WIDE: rc = slf_fpga_leds_wide_ioctl(xsp, raw); break;
+	  case SLF_FPGA_DEBOUNCE: rc = slf_fpga_debounce_ioctl(xsp, raw); break;
+	  case SLF_FPGA_SNAPSHOT: rc = slf_fpga_snapshot_ioctl(xsp, raw); break;
+	  default:              rc = -ENOTTY; break;
       }
+
+ out:
+      up_read(&xsp->remove_sem);
+      trace_slf_fpga_ioctl_exit(xsp->minor, cmd, rc);
+
+      return rc;
 }
 
+/*
+ * Record a new user input value in the event ring, if it is different
+ * from the last value, and update the snapshot to match. The ring slot
+ * is overwritten if it is full, and the readers detect that and count
+ * the dropped events. The caller must hold the instance lock.
+ */
+static bool slf_fpga_record_event(struct slf_fpga_instance*xsp, uint64_t timestamp_ns, uint32_t user_in)
+{
+      if (user_in == xsp->user_in_last)
+	    return false;
+
+      unsigned idx = xsp->event_seq & (SLF_FPGA_EVENT_RING-1);
+      struct slf_fpga_event_s*evp = xsp->event_ring + idx;
+      evp->timestamp_ns = timestamp_ns;
+      evp->user_in_old = xsp->user_in_last;
+      evp->user_in_new = user_in;
+      xsp->event_seq += 1;
+
+      struct slf_fpga_snapshot_s*snap = xsp->snapshot;
+      uint32_t changed = (user_in ^ xsp->user_in_last) & 0xff;
+      slf_fpga_snapshot_write_begin(snap);
+      snap->user_in = user_in;
+      snap->event_seq = xsp->event_seq;
+      snap->timestamp_ns = timestamp_ns;
+      for (unsigned bit = 0 ; changed ; bit += 1, changed >>= 1) {
+	    if (changed & 1) snap->bit_changes[bit] += 1;
+      }
+      slf_fpga_snapshot_write_end(snap);
+
+      xsp->user_in_last = user_in;
+      return true;
+}
+
+/*
+ * The interrupt may be shared with other devices, including other
+ * slf_fpga instances. If no change flags are set, then it was not
+ * this device that interrupted.
+ *
+ * A single read of InterruptStatus gives the change flags, the current
+ * inputs and the change FIFO level, and a single write acknowledges
+ * the flags. Acknowledge before draining the FIFO, so that a change
+ * that lands during the drain raises a new interrupt. The FifoPop
+ * reads (and the counter reads that date them) are only needed when
+ * there are changes to collect.
+ */
 static irqreturn_t slf_fpga_isr(int irq, void*dev_id)
 {
       struct slf_fpga_instance*xsp = (struct slf_fpga_instance*)dev_id;
-      uint32_t user_in = slf_fpga_read32(xsp, ADDR_UserIn);
-      slf_fpga_write32(xsp, ADDR_UserInExp, user_in);
+      struct slf_fpga_event_s change;
+      bool changed = false;
 
-	/* Wake up threads that may be waiting for button changes. */
-      wake_up_interruptible(&xsp->userin_sync);
+      uint32_t status = slf_fpga_read32(xsp, ADDR_InterruptStatus);
+      trace_slf_fpga_isr_enter(xsp->minor, status);
+
+	/* Only the flags that we enabled are ours. Anything else is
+	   another device on a shared line. */
+      uint32_t flags = status & INT_STATUS_CHANGED & READ_ONCE(xsp->user_in_ien);
+      if (flags == 0) {
+	    trace_slf_fpga_isr_exit(xsp->minor, INT_STATUS_USER_IN(status), 0, false);
+	    return IRQ_NONE;
+      }
+      slf_fpga_write32(xsp, ADDR_InterruptStatus, flags);
+
+      spin_lock(&xsp->lock);
+      uint64_t seq_start = xsp->event_seq;
+      change.user_in_old = xsp->user_in_last;
+      uint64_t now_ns = ktime_get_ns();
+
+      if (status & INT_STATUS_OVERFLOW) {
+	    xsp->fifo_overflows += 1;
+	    slf_fpga_write32(xsp, ADDR_FifoStatus, FIFO_STATUS_OVERFLOW);
+      }
+
+	/* Drain the change FIFO. Each entry has the low 24 bits of
+	   the device clock count when the change happened, so work
+	   back from the current time to get the time of the change.
+	   The level is from the status read, so all the entries we
+	   pop are older than now_cycles. The counters are read
+	   through the Peek registers, so that the ISR does not reload
+	   the high word latches under a user of the mapped registers.
+
+	   No entry is older than the interrupt by more than the
+	   holdoff, so if the interrupt latency is short enough, the
+	   ages cannot have wrapped. If the ISR is later than that,
+	   the ages are ambiguous, so date the entries at the
+	   interrupt, and leave them out of the histogram. */
+      uint32_t level = INT_STATUS_LEVEL(status);
+      if (level > 0) {
+	    uint32_t now_cycles = slf_fpga_read32(xsp, ADDR_CycleCountPeek);
+	    uint32_t irq_cycles = slf_fpga_read32(xsp, ADDR_IrqStampPeek);
+	    uint32_t irq_age = now_cycles - irq_cycles;
+	    uint64_t irq_age_ns = slf_fpga_clocks_to_ns(xsp, irq_age);
+	    bool age_valid = irq_age <= FIFO_POP_TIME_MASK - IRQ_HOLDOFF_MAX;
+	    slf_fpga_latency_record(xsp, LATENCY_IRQ_TO_ISR, irq_age_ns);
+	    while (level > 0) {
+		  uint32_t entry = slf_fpga_read32(xsp, ADDR_FifoPop);
+		  uint64_t age_ns = irq_age_ns;
+		  if (age_valid) {
+			uint32_t age = (now_cycles - (entry >> 8)) & FIFO_POP_TIME_MASK;
+			age_ns = slf_fpga_clocks_to_ns(xsp, age);
+			slf_fpga_latency_record(xsp, LATENCY_EDGE_TO_ISR, age_ns);
+		  }
+		  changed |= slf_fpga_record_event(xsp, now_ns - age_ns, entry & 0xff);
+		  level -= 1;
+	    }
+      }
+
+	/* Finish with the input value from the status. It is never
+	   older than the FIFO entries, so this is a no-op unless the
+	   FIFO was empty, or it overflowed and lost the latest
+	   changes. */
+      changed |= slf_fpga_record_event(xsp, now_ns, INT_STATUS_USER_IN(status));
+
+      if (changed)
+	    xsp->isr_ns = now_ns;
+
+      change.timestamp_ns = now_ns;
+      change.user_in_new = xsp->user_in_last;
+      unsigned events = xsp->event_seq - seq_start;
+      spin_unlock(&xsp->lock);
+
+      trace_slf_fpga_isr_exit(xsp->minor, change.user_in_new, events, true);
+
+	/* The flags were set, so this device did interrupt. But if
+	   the FIFO overflowed, an input that changed and changed back
+	   may leave nothing new for the waiters. */
+      if (changed) {
+	      /* Wake only the WAIT2 threads that care about this change. */
+	    __wake_up(&xsp->wait2_sync, TASK_INTERRUPTIBLE, 0, &change);
+
+	      /* Wake up threads that may be waiting for button changes. */
+	    wake_up_interruptible(&xsp->userin_sync);
+      }
 
       return IRQ_HANDLED;
 }
@@ -219,10 +1362,64 @@ static irqreturn_t slf_fpga_isr(int irq, void*dev_id)
 const struct file_operations slf_fpga_ops = {
       .open           = slf_fpga_open,
       .release        = slf_fpga_release,
+      .read           = slf_fpga_read,
+      .poll           = slf_fpga_poll,
+      .mmap           = slf_fpga_mmap,
       .unlocked_ioctl = slf_fpga_ioctl,
       .owner          = THIS_MODULE
 };
 
+/*
+ * The debugfs files for the latency histograms. Read "latency" to get
+ * a report of all the histograms, and write anything to
+ * "latency_reset" to clear them.
+ */
+static int slf_fpga_latency_show(struct seq_file*sfp, void*unused)
+{
+      unsigned long flags;
+      struct slf_fpga_instance*xsp = sfp->private;
+      struct slf_fpga_latency snap;
+      unsigned kind, idx;
+
+      for (kind = 0 ; kind < LATENCY_COUNT ; kind += 1) {
+	    spin_lock_irqsave(&xsp->lock, flags);
+	    snap = xsp->latency[kind];
+	    spin_unlock_irqrestore(&xsp->lock, flags);
+
+	    seq_printf(sfp, "%s: samples=%llu max=%llu ns mean=%llu ns\n",
+		       slf_fpga_latency_names[kind], snap.samples, snap.max_ns,
+		       snap.samples? div64_u64(snap.total_ns, snap.samples) : 0);
+	    for (idx = 0 ; idx < SLF_FPGA_LATENCY_BUCKETS ; idx += 1) {
+		  if (snap.bucket[idx] == 0)
+			continue;
+		  seq_printf(sfp, "  >= %12llu ns: %llu\n",
+			     idx == 0? 0ULL : 1ULL << idx, snap.bucket[idx]);
+	    }
+      }
+
+      return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(slf_fpga_latency);
+
+static ssize_t slf_fpga_latency_reset_write(struct file*filp, const char __user*buf,
+					    size_t count, loff_t*off)
+{
+      unsigned long flags;
+      struct slf_fpga_instance*xsp = filp->private_data;
+
+      spin_lock_irqsave(&xsp->lock, flags);
+      memset(xsp->latency, 0, sizeof xsp->latency);
+      spin_unlock_irqrestore(&xsp->lock, flags);
+
+      return count;
+}
+
+static const struct file_operations slf_fpga_latency_reset_fops = {
+      .open  = simple_open,
+      .write = slf_fpga_latency_reset_write,
+      .owner = THIS_MODULE
+};
+
 /*
  * The driver calls the probe function for all the devices in the
  * device-tree that are compatible with this driver. We get the
@@ -230,22 +1427,42 @@ const struct file_operations slf_fpga_ops = {
  */
 static int slf_fpga_probe(struct platform_device*dev)
 {
+      int rc;
       struct resource *res;
-      struct slf_fpga_instance*xsp = slf_instance_table;
-      if (xsp->base) {
-	    printk(KERN_INFO "%s: Can only have one device instance!\n", DRIVER_NAME);
-	    return -ENODEV;
-      }
 
+	/* The instance is not a devm_* allocation, because open
+	   files may still refer to it after the device is removed.
+	   It is reference counted instead. */
+      struct slf_fpga_instance*xsp = kzalloc(sizeof(struct slf_fpga_instance), GFP_KERNEL);
+      if (xsp == 0)
+	    return -ENOMEM;
+
+      kref_init(&xsp->ref);
+      init_rwsem(&xsp->remove_sem);
       init_waitqueue_head(&xsp->userin_sync);
+      init_waitqueue_head(&xsp->wait2_sync);
+      spin_lock_init(&xsp->lock);
+      mutex_init(&xsp->seq_lock);
+      xsp->open_count = 0;
+      xsp->event_seq = 0;
+
+      xsp->aclk_hz = slf_fpga_aclk_hz;
+      of_property_read_u32(dev->dev.of_node, "clock-frequency", &xsp->aclk_hz);
+      if (xsp->aclk_hz == 0) {
+	    printk(KERN_INFO DRIVER_NAME ": invalid clock-frequency.\n");
+	    rc = -EINVAL;
+	    goto out_put;
+      }
 
       res = platform_get_resource(dev, IORESOURCE_MEM, 0);
       if (res == 0) {
 	    printk(KERN_INFO DRIVER_NAME ": no memory resource.\n");
-	    xsp->base = 0;
-	    return -ENODEV;
+	    rc = -ENODEV;
+	    goto out_put;
       }
       printk(KERN_INFO DRIVER_NAME ": Memory at %pr\n", res);
+      xsp->regs_phys = res->start;
+      xsp->regs_size = resource_size(res);
 
 	/* Map the registers. Return an error if the map fails. The
 	   devm_* variant here arranges for the resources to be
@@ -253,13 +1470,25 @@ static int slf_fpga_probe(struct platform_device*dev)
 	   removed. */
       xsp->base = devm_ioremap_resource(&dev->dev, res);
       if (IS_ERR(xsp->base)) {
-	    int rc = PTR_ERR(xsp->base);
-	    xsp->base = 0;
-	    return rc;
+	    rc = PTR_ERR(xsp->base);
+	    goto out_put;
       }
 
+	/* The snapshot gets a whole page, so that it can be mapped.
+	   It is freed with the instance, not by devm, because it can
+	   still be mapped after the device is removed. */
+      xsp->snapshot_page = alloc_page(GFP_KERNEL|__GFP_ZERO);
+      if (xsp->snapshot_page == 0) {
+	    rc = -ENOMEM;
+	    goto out_put;
+      }
+      xsp->snapshot = (struct slf_fpga_snapshot_s*)page_address(xsp->snapshot_page);
+
 	/* Make sure the device is in a ready, but quiet, state. */
       slf_fpga_write32(xsp, ADDR_UserInIEN, 0x00000000);
+      slf_fpga_write32(xsp, ADDR_IrqModerate, 0x00000000);
+      slf_fpga_write32(xsp, ADDR_SeqControl, 0x00000000);
+      slf_fpga_write32(xsp, ADDR_PwmControl, 0x00000000);
 
 	/* Bind the interrupt request to the interrupt handler. */
       res = platform_get_resource(dev, IORESOURCE_IRQ, 0);
@@ -268,35 +1497,78 @@ static int slf_fpga_probe(struct platform_device*dev)
       } else {
 	    printk(KERN_INFO DRIVER_NAME ": IRQ at %pr\n", res);
 	    unsigned int use_irq = res->start;
-	    int rc = devm_request_irq(&dev->dev, use_irq, slf_fpga_isr,
-				      IRQF_SHARED, DRIVER_NAME, xsp);
+	    rc = devm_request_irq(&dev->dev, use_irq, slf_fpga_isr,
+				  IRQF_SHARED, DRIVER_NAME, xsp);
 	    if (rc < 0) printk(KERN_INFO DRIVER_NAME ": IRQ request failed.\n");
+	    else xsp->have_irq = true;
+	    xsp->irq = use_irq;
+      }
+
+	/* Give the instance a minor number, so that it can be
+	   opened. Do this last, when the device is ready. */
+      rc = slf_fpga_alloc_minor(xsp);
+      if (rc < 0) {
+	    printk(KERN_INFO DRIVER_NAME ": Too many device instances!\n");
+	    if (xsp->have_irq)
+		  devm_free_irq(&dev->dev, xsp->irq, xsp);
+	    goto out_put;
       }
 
-      
 	/* This binds the instance pointer to the device pointer, so
 	   that we can get at it later. */
       platform_set_drvdata(dev, xsp);
 
+	/* Debugfs is optional, so errors are not checked here. */
+      char debug_name[32];
+      snprintf(debug_name, sizeof debug_name, DRIVER_NAME "%d", xsp->minor);
+      xsp->debug_dir = debugfs_create_dir(debug_name, 0);
+      debugfs_create_file("latency", 0444, xsp->debug_dir, xsp, &slf_fpga_latency_fops);
+      debugfs_create_file("latency_reset", 0200, xsp->debug_dir, xsp, &slf_fpga_latency_reset_fops);
+
       u32 tmp = slf_fpga_read32(xsp, 0);
-      printk(KERN_INFO DRIVER_NAME ": BUILD ID = %u\n", tmp);
+      printk(KERN_INFO DRIVER_NAME "%d: BUILD ID = %u\n", xsp->minor, tmp);
 
       return 0;
+
+ out_put:
+      slf_fpga_instance_put(xsp);
+      return rc;
 }
 
 /*
  * This is called when the driver is being removed from the
  * system. Make sure the device (if bound) is in a safe state, and
- * release the instance data.
+ * release the minor number. Files that are still open keep the
+ * instance, but it is marked dead so that they stop using the
+ * hardware, and it is deleted when the last of them is closed.
  */
 static int slf_fpga_remove(struct platform_device*dev)
 {
       struct slf_fpga_instance*xsp = platform_get_drvdata(dev);
       if (xsp) {
+	      /* No more opens. Then wake up the threads that are
+		 waiting, so that they see that the device is dead
+		 and let go of the remove_sem. */
+	    slf_fpga_free_minor(xsp);
+	    WRITE_ONCE(xsp->dead, true);
+	    wake_up_all(&xsp->userin_sync);
+	    wake_up_all(&xsp->wait2_sync);
+
 	      /* Make sure device is in a safe state. */
+	    down_write(&xsp->remove_sem);
+	    WRITE_ONCE(xsp->user_in_ien, 0x00);
 	    slf_fpga_write32(xsp, ADDR_UserInIEN, 0x00000000);
+	    slf_fpga_write32(xsp, ADDR_InterruptEdge, INT_EDGE_BOTH);
+	    up_write(&xsp->remove_sem);
+
+	      /* The devm machinery would free the IRQ after this
+		 returns, but the instance may be gone by then. */
+	    if (xsp->have_irq)
+		  devm_free_irq(&dev->dev, xsp->irq, xsp);
 
-	    xsp->base = 0;
+	    debugfs_remove_recursive(xsp->debug_dir);
+	    platform_set_drvdata(dev, 0);
+	    slf_fpga_instance_put(xsp);
 	    xsp = 0;
       }
 
@@ -70,4 +70,233 @@ struct slf_fpga_wait_s {
 };
 # define SLF_FPGA_WAIT _IOWR('F',0x12,struct slf_fpga_wait_s)
 
+/*
+ * This is a more selective version of the WAIT ioctl. The mask selects
+ * the user inputs of interest, and the edges selects which kinds of
+ * differences from user_in_exp count. A rising edge is a bit that is
+ * expected to be 0 but is actually 1, and a falling edge is a bit that
+ * is expected to be 1 but is actually 0. An edges value of 0 is the
+ * same as SLF_FPGA_EDGE_BOTH.
+ *
+ * The thread is only woken by changes to the bits that it is
+ * interested in, so many threads can each wait on their own inputs.
+ *
+ * If timeout_ms is non-zero, the ioctl gives up after that many
+ * milliseconds and fails with errno ETIMEDOUT. The user_in_value is
+ * updated with the current value of the user inputs in that case too.
+ */
+# define SLF_FPGA_EDGE_RISING  0x01
+# define SLF_FPGA_EDGE_FALLING 0x02
+# define SLF_FPGA_EDGE_BOTH    0x03
+struct slf_fpga_wait2_s {
+      uint32_t user_in_value;
+      uint32_t user_in_exp;
+      uint32_t mask;
+      uint32_t edges;
+      uint32_t timeout_ms;
+};
+# define SLF_FPGA_WAIT2 _IOWR('F',0x15,struct slf_fpga_wait2_s)
+
+/*
+ * The driver records every change of the user inputs as an event,
+ * and a read() of the device returns these events as an array of
+ * struct slf_fpga_event_s records. The read will return as many whole
+ * records as are available and fit, so the read size should be a
+ * multiple of the record size. The read blocks until there is at
+ * least one event, unless the file is opened O_NONBLOCK.
+ *
+ * The timestamp_ns is the CLOCK_MONOTONIC time that the driver saw
+ * the change, and the user_in_old/user_in_new are the values of the
+ * user inputs before and after the change. The bits are assigned the
+ * same as for the UserIn ioctl.
+ *
+ * Each open file has its own position in the event stream, and only
+ * sees events that happen after it is opened. If the reader falls too
+ * far behind, the oldest events are lost. The EVENT_STATS ioctl
+ * reports how many events this file has lost that way, and how many
+ * are still waiting to be read.
+ *
+ * The hardware collects the changes, with timestamps, in a FIFO, so
+ * that changes are not lost even if the interrupt handler is slow.
+ * The fifo_overflows count is the number of times the hardware FIFO
+ * overflowed for the device, so that changes were lost.
+ *
+ * The device also supports poll/select/epoll, and is readable when
+ * there are events that this file has not yet read.
+ */
+struct slf_fpga_event_s {
+      uint64_t timestamp_ns;
+      uint32_t user_in_old;
+      uint32_t user_in_new;
+};
+
+struct slf_fpga_event_stats_s {
+      uint32_t events_pending;
+      uint32_t events_dropped;
+      uint32_t fifo_overflows;
+};
+# define SLF_FPGA_EVENT_STATS _IOR('F',0x13,struct slf_fpga_event_stats_s)
+
+/*
+ * Run a batch of register operations in one call. The ops points to
+ * an array of count struct slf_fpga_batch_op_s entries, which are
+ * executed in order, all while holding the device lock. This makes
+ * the sequence atomic with respect to other threads and the
+ * interrupt handler. The address is the byte address of the register
+ * (see slf_fpga_regs.h) and the op is one of:
+ *
+ *   SLF_FPGA_BATCH_READ   - value = register & mask
+ *   SLF_FPGA_BATCH_WRITE  - register = value (the mask is ignored)
+ *   SLF_FPGA_BATCH_MODIFY - register = (register & ~mask) | (value & mask)
+ *                           and value = the register before the change
+ *
+ * The entries are written back to the user's array, so the results of
+ * reads are in the value fields. All the entries are checked before
+ * any are executed, so an invalid entry means nothing was done.
+ * The interrupt control registers and FifoStatus are owned by the
+ * driver, and can be read but not written. A write or modify of the
+ * LEDs register clears the Wide bit of PwmControl, the same as
+ * SLF_FPGA_LEDS does, so that the new levels take effect.
+ */
+# define SLF_FPGA_BATCH_READ   0
+# define SLF_FPGA_BATCH_WRITE  1
+# define SLF_FPGA_BATCH_MODIFY 2
+# define SLF_FPGA_BATCH_MAX    64
+struct slf_fpga_batch_op_s {
+      uint32_t op;
+      uint32_t address;
+      uint32_t mask;
+      uint32_t value;
+};
+
+struct slf_fpga_batch_s {
+      uint64_t ops;
+      uint32_t count;
+      uint32_t reserved;
+};
+# define SLF_FPGA_BATCH _IOW('F',0x14,struct slf_fpga_batch_s)
+
+/*
+ * Set the interrupt moderation for the device. After an interrupt,
+ * the next interrupt is held off until holdoff_clocks device clocks
+ * have passed, or until event_count input changes have happened,
+ * whichever comes first. This trades latency for fewer interrupts
+ * when the inputs are busy. An event_count of 0 means no count limit,
+ * and a holdoff_clocks of 0 turns moderation off. The holdoff_clocks
+ * is limited to 0x3fffff, so that the driver can still date the input
+ * changes from their 24-bit hardware timestamps, and the event_count
+ * is limited to 8 bits. The IrqModerate register can only be set
+ * through this ioctl.
+ */
+struct slf_fpga_irq_moderate_s {
+      uint32_t holdoff_clocks;
+      uint32_t event_count;
+};
+# define SLF_FPGA_IRQ_MODERATE _IOW('F',0x16,struct slf_fpga_irq_moderate_s)
+
+/*
+ * Load the LED sequencer. The sequencer plays a sequence of frames to
+ * the LEDs, each frame for period_clocks device clocks, without any
+ * help from software. The frames points to an array of count LEDs
+ * values (the same format as for SLF_FPGA_LEDS), and count is from 1
+ * to SLF_FPGA_SEQ_FRAMES. The flags are a combination of:
+ *
+ *   SLF_FPGA_SEQ_RUN  - Start the sequence as soon as it is loaded
+ *   SLF_FPGA_SEQ_LOOP - Start over after the last frame, otherwise
+ *                       stop after the last frame.
+ *
+ * Any running sequence is stopped while the new one is loaded. While
+ * the sequencer is running, it overrides the SLF_FPGA_LEDS setting.
+ */
+# define SLF_FPGA_SEQ_FRAMES 256
+# define SLF_FPGA_SEQ_RUN    0x01
+# define SLF_FPGA_SEQ_LOOP   0x02
+struct slf_fpga_seq_load_s {
+      uint64_t frames;
+      uint32_t count;
+      uint32_t period_clocks;
+      uint32_t flags;
+      uint32_t reserved;
+};
+# define SLF_FPGA_SEQ_LOAD _IOW('F',0x17,struct slf_fpga_seq_load_s)
+
+/*
+ * Start or stop the loaded sequence, and get its status. The flags are
+ * the same as for SLF_FPGA_SEQ_LOAD, and setting SLF_FPGA_SEQ_RUN
+ * starts the sequence from the first frame. On return, the flags are
+ * the state of the sequencer before the change, and the frame is the
+ * frame that the sequencer was playing.
+ */
+struct slf_fpga_seq_control_s {
+      uint32_t flags;
+      uint32_t frame;
+};
+# define SLF_FPGA_SEQ_CONTROL _IOWR('F',0x18,struct slf_fpga_seq_control_s)
+
+/*
+ * Set the LEDs to 8-bit brightness levels, from 0 (off) to 255 (full
+ * on), instead of the 4-bit levels of SLF_FPGA_LEDS. The level array
+ * is indexed by LED number. The flags are a combination of:
+ *
+ *   SLF_FPGA_LED_GAMMA - Gamma correct the levels, so that even steps
+ *                        in level look like even steps in brightness.
+ *
+ * The wide levels stay in effect until the next SLF_FPGA_LEDS, which
+ * switches back to 4-bit levels but keeps the gamma setting.
+ */
+# define SLF_FPGA_LED_GAMMA 0x01
+struct slf_fpga_leds_wide_s {
+      uint8_t  level[8];
+      uint32_t flags;
+      uint32_t reserved;
+};
+# define SLF_FPGA_LEDS_WIDE _IOW('F',0x19,struct slf_fpga_leds_wide_s)
+
+/*
+ * Set the debounce filter for the user inputs. An input must be stable
+ * for filter_ns nanoseconds before a change is accepted. The inputs in
+ * the fast_mask (using the same bit numbers as SLF_FPGA_UserIn) instead
+ * report the first edge right away, then ignore the input until it has
+ * been stable for filter_ns. This is the low latency choice for push
+ * buttons. The device counts the filter in coarse ticks, so on return
+ * filter_ns is the (rounded up) filter time actually in effect.
+ */
+struct slf_fpga_debounce_s {
+      uint32_t filter_ns;
+      uint32_t fast_mask;
+};
+# define SLF_FPGA_DEBOUNCE _IOWR('F',0x1a,struct slf_fpga_debounce_s)
+
+/*
+ * The device can also be mmapped, at offset 0, to give direct access
+ * to the device registers. The slf_fpga_regs.h header describes the
+ * register layout, and has a C++ class that wraps this up.
+ */
+# define SLF_FPGA_MMAP_SIZE 4096
+
+/*
+ * The driver keeps a snapshot of the user inputs, which the interrupt
+ * handler updates on every change. The user_in is the current value,
+ * event_seq counts all the changes, timestamp_ns is the
+ * CLOCK_MONOTONIC time of the last change, and bit_changes counts the
+ * changes of each input bit. The snapshot is only kept up to date
+ * while the device is open.
+ *
+ * The SNAPSHOT ioctl returns a consistent copy. The snapshot can also
+ * be mmapped read-only, at offset SLF_FPGA_MMAP_SNAPSHOT, so that it
+ * can be checked with no system call and no bus access. The seq field
+ * protects the mapped copy, as a seqlock: it is odd while an update is
+ * in progress, so a reader must read seq, then the other fields, then
+ * seq again, and retry if seq was odd or changed.
+ */
+struct slf_fpga_snapshot_s {
+      uint32_t seq;
+      uint32_t user_in;
+      uint64_t event_seq;
+      uint64_t timestamp_ns;
+      uint32_t bit_changes[8];
+};
+# define SLF_FPGA_SNAPSHOT _IOR('F',0x1b,struct slf_fpga_snapshot_s)
+# define SLF_FPGA_MMAP_SNAPSHOT 0x100000
+
 #endif
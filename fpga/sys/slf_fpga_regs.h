@@ -0,0 +1,142 @@
+#ifndef __slf_fpga_regs_H
+#define __slf_fpga_regs_H
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is direct user mode access to the slf_fpga registers, through
+ * an mmap of the device. Register accesses are plain loads and stores
+ * to the mapped window, without any system calls.
+ *
+ * The UserInExp and UserInIEN registers are managed by the driver
+ * (its interrupt handler writes UserInExp) so they are read-only here.
+ * Reading FifoPop would steal changes from the interrupt handler, so
+ * there is no accessor for it.
+ * Use the ioctl and read interfaces to work with user input changes.
+ */
+# include  "slf_fpga.h"
+# include  <sys/mman.h>
+
+class slf_fpga_regs {
+
+    public:
+	// Byte offsets of the registers in the mapped window.
+      enum addr_t {
+	    ADDR_BUILD_ID  = 0x00,
+	    ADDR_LEDs      = 0x04,
+	    ADDR_UserIn    = 0x08,
+	    ADDR_UserInExp = 0x0c,
+	    ADDR_UserInIEN = 0x10,
+	    ADDR_IrqModerate = 0x14,
+	    ADDR_CycleCount = 0x18,
+	    ADDR_FifoStatus = 0x1c,
+	    ADDR_FifoPop    = 0x20,
+	    ADDR_CycleCountHi = 0x24,
+	    ADDR_IrqStamp   = 0x28,
+	    ADDR_IrqStampHi = 0x2c,
+	    ADDR_SeqControl = 0x30,
+	    ADDR_SeqPeriod  = 0x34,
+	    ADDR_SeqLength  = 0x38,
+	    ADDR_PwmControl = 0x3c,
+	    ADDR_LEDsWide0  = 0x40,
+	    ADDR_LEDsWide1  = 0x44,
+	    ADDR_DebounceControl = 0x48,
+	    ADDR_DebounceTick = 0x4c,
+	    ADDR_InterruptStatus = 0x50,
+	    ADDR_InterruptEdge = 0x54,
+	    ADDR_CycleCountPeek = 0x58,
+	    ADDR_IrqStampPeek = 0x5c,
+	    ADDR_SeqFrames  = 0x400
+      };
+
+	// Map the registers of an opened slf_fpga device. If the
+	// device was opened O_RDONLY, the mapping is read-only, and
+	// the LEDs cannot be written.
+      explicit slf_fpga_regs(int dev, bool writable =true)
+      {
+	    int prot = writable? PROT_READ|PROT_WRITE : PROT_READ;
+	    void*ptr = mmap(0, SLF_FPGA_MMAP_SIZE, prot, MAP_SHARED, dev, 0);
+	    base_ = ptr == MAP_FAILED? 0 : (volatile uint32_t*)ptr;
+      }
+
+      ~slf_fpga_regs()
+      {
+	    if (base_) munmap((void*)base_, SLF_FPGA_MMAP_SIZE);
+      }
+
+	// True if the mmap worked.
+      bool is_mapped() const { return base_ != 0; }
+
+      uint32_t build_id() const    { return read32(ADDR_BUILD_ID); }
+      uint32_t leds() const        { return read32(ADDR_LEDs); }
+      uint32_t user_in() const     { return read32(ADDR_UserIn); }
+      uint32_t user_in_exp() const { return read32(ADDR_UserInExp); }
+      uint32_t user_in_ien() const { return read32(ADDR_UserInIEN); }
+      uint32_t irq_moderate() const { return read32(ADDR_IrqModerate); }
+      uint32_t cycle_count() const { return read32(ADDR_CycleCount); }
+      uint32_t fifo_status() const { return read32(ADDR_FifoStatus); }
+      uint32_t seq_control() const { return read32(ADDR_SeqControl); }
+      uint32_t pwm_control() const { return read32(ADDR_PwmControl); }
+      uint32_t debounce_control() const { return read32(ADDR_DebounceControl); }
+      uint32_t debounce_tick() const { return read32(ADDR_DebounceTick); }
+      uint32_t interrupt_status() const { return read32(ADDR_InterruptStatus); }
+      uint32_t interrupt_edge() const { return read32(ADDR_InterruptEdge); }
+
+	// The 8-bit level of LED number idx (0-7).
+      uint8_t led_level(unsigned idx) const
+      {
+	    uint32_t val = read32(idx < 4? ADDR_LEDsWide0 : ADDR_LEDsWide1);
+	    return (val >> (8 * (idx % 4))) & 0xff;
+      }
+
+	// The 64-bit counters. Reading the low word latches the high
+	// word, so the low word must be read first. The latch is
+	// shared with other users of the mapping, so these are not
+	// safe to call from more than one thread at a time. The
+	// driver itself uses the Peek registers, which do not latch.
+      uint64_t cycle_count64() const
+      {
+	    uint32_t lo = read32(ADDR_CycleCount);
+	    uint32_t hi = read32(ADDR_CycleCountHi);
+	    return ((uint64_t)hi << 32) | lo;
+      }
+      uint64_t irq_stamp() const
+      {
+	    uint32_t lo = read32(ADDR_IrqStamp);
+	    uint32_t hi = read32(ADDR_IrqStampHi);
+	    return ((uint64_t)hi << 32) | lo;
+      }
+
+	// Set the LEDs. The format is the same as for the
+	// SLF_FPGA_LEDS ioctl.
+      void leds(uint32_t val)      { write32(ADDR_LEDs, val); }
+
+    private:
+      uint32_t read32(addr_t addr) const { return base_[addr/4]; }
+      void write32(addr_t addr, uint32_t val) { base_[addr/4] = val; }
+
+    private:
+      volatile uint32_t*base_;
+
+    private: // not implemented
+      slf_fpga_regs(const slf_fpga_regs&);
+      slf_fpga_regs& operator= (const slf_fpga_regs&);
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tracepoints for the slf_fpga driver. Enable them with perf or
+ * through /sys/kernel/tracing/events/slf_fpga. The tracepoints cost
+ * next to nothing when they are not enabled. The extra register reads
+ * and clock samples that some of them need are only done when the
+ * tracepoint is enabled.
+ *
+ * This header is read several times by the trace machinery, so it
+ * must not have the usual include guard.
+ */
+# undef TRACE_SYSTEM
+# define TRACE_SYSTEM slf_fpga
+
+#if !defined(__slf_fpga_trace_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __slf_fpga_trace_H
+
+# include  <linux/tracepoint.h>
+# include  "slf_fpga.h"
+
+/*
+ * The wait events are shared by the blocking read (cmd==0), and the
+ * SLF_FPGA_WAIT and SLF_FPGA_WAIT2 ioctls.
+ */
+# define show_slf_fpga_wait_cmd(cmd) __print_symbolic(cmd,	\
+      { 0,              "read" },				\
+      { SLF_FPGA_WAIT,  "WAIT" },				\
+      { SLF_FPGA_WAIT2, "WAIT2" })
+
+TRACE_EVENT(slf_fpga_isr_enter,
+	    TP_PROTO(int minor, uint32_t status),
+	    TP_ARGS(minor, status),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(uint32_t, status)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor  = minor;
+		  __entry->status = status;
+		  ),
+	    TP_printk("minor=%d InterruptStatus=0x%08x",
+		      __entry->minor, __entry->status)
+      );
+
+TRACE_EVENT(slf_fpga_isr_exit,
+	    TP_PROTO(int minor, uint32_t user_in, unsigned events, bool handled),
+	    TP_ARGS(minor, user_in, events, handled),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(uint32_t, user_in)
+		  __field(unsigned, events)
+		  __field(bool,     handled)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor    = minor;
+		  __entry->user_in  = user_in;
+		  __entry->events   = events;
+		  __entry->handled  = handled;
+		  ),
+	    TP_printk("minor=%d UserIn=0x%02x events=%u handled=%d",
+		      __entry->minor, __entry->user_in,
+		      __entry->events, __entry->handled)
+      );
+
+TRACE_EVENT(slf_fpga_wait_enter,
+	    TP_PROTO(int minor, unsigned cmd, uint32_t user_in_exp, uint32_t mask),
+	    TP_ARGS(minor, cmd, user_in_exp, mask),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(unsigned, cmd)
+		  __field(uint32_t, user_in_exp)
+		  __field(uint32_t, mask)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor       = minor;
+		  __entry->cmd         = cmd;
+		  __entry->user_in_exp = user_in_exp;
+		  __entry->mask        = mask;
+		  ),
+	    TP_printk("minor=%d %s UserInExp=0x%02x mask=0x%02x",
+		      __entry->minor, show_slf_fpga_wait_cmd(__entry->cmd),
+		      __entry->user_in_exp, __entry->mask)
+      );
+
+TRACE_EVENT(slf_fpga_wait_wake,
+	    TP_PROTO(int minor, unsigned cmd),
+	    TP_ARGS(minor, cmd),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(unsigned, cmd)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor = minor;
+		  __entry->cmd   = cmd;
+		  ),
+	    TP_printk("minor=%d %s",
+		      __entry->minor, show_slf_fpga_wait_cmd(__entry->cmd))
+      );
+
+TRACE_EVENT(slf_fpga_wait_exit,
+	    TP_PROTO(int minor, unsigned cmd, long rc, uint32_t user_in),
+	    TP_ARGS(minor, cmd, rc, user_in),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(unsigned, cmd)
+		  __field(long,     rc)
+		  __field(uint32_t, user_in)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor   = minor;
+		  __entry->cmd     = cmd;
+		  __entry->rc      = rc;
+		  __entry->user_in = user_in;
+		  ),
+	    TP_printk("minor=%d %s rc=%ld UserIn=0x%02x",
+		      __entry->minor, show_slf_fpga_wait_cmd(__entry->cmd),
+		      __entry->rc, __entry->user_in)
+      );
+
+TRACE_EVENT(slf_fpga_ioctl_enter,
+	    TP_PROTO(int minor, unsigned cmd),
+	    TP_ARGS(minor, cmd),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(unsigned, cmd)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor = minor;
+		  __entry->cmd   = cmd;
+		  ),
+	    TP_printk("minor=%d cmd=0x%08x", __entry->minor, __entry->cmd)
+      );
+
+TRACE_EVENT(slf_fpga_ioctl_exit,
+	    TP_PROTO(int minor, unsigned cmd, long rc),
+	    TP_ARGS(minor, cmd, rc),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(unsigned, cmd)
+		  __field(long,     rc)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor = minor;
+		  __entry->cmd   = cmd;
+		  __entry->rc    = rc;
+		  ),
+	    TP_printk("minor=%d cmd=0x%08x rc=%ld",
+		      __entry->minor, __entry->cmd, __entry->rc)
+      );
+
+/*
+ * Every register access, with the time that the access took. The
+ * time is measured only when this event is enabled.
+ */
+TRACE_EVENT(slf_fpga_mmio,
+	    TP_PROTO(int minor, unsigned offset, uint32_t value, bool write, uint64_t duration_ns),
+	    TP_ARGS(minor, offset, value, write, duration_ns),
+	    TP_STRUCT__entry(
+		  __field(int,      minor)
+		  __field(unsigned, offset)
+		  __field(uint32_t, value)
+		  __field(bool,     write)
+		  __field(uint64_t, duration_ns)
+		  ),
+	    TP_fast_assign(
+		  __entry->minor       = minor;
+		  __entry->offset      = offset;
+		  __entry->value       = value;
+		  __entry->write       = write;
+		  __entry->duration_ns = duration_ns;
+		  ),
+	    TP_printk("minor=%d %s 0x%02x value=0x%08x duration=%llu ns",
+		      __entry->minor, __entry->write? "write" : "read",
+		      __entry->offset, __entry->value,
+		      (unsigned long long)__entry->duration_ns)
+      );
+
+#endif
+
+/* This part must be outside the include guard. */
+# undef TRACE_INCLUDE_PATH
+# define TRACE_INCLUDE_PATH .
+# undef TRACE_INCLUDE_FILE
+# define TRACE_INCLUDE_FILE slf_fpga_trace
+# include  <trace/define_trace.h>
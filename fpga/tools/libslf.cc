@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "libslf.h"
+# include  "slf_fpga_regs.h"
+# include  <cerrno>
+# include  <cstdlib>
+# include  <cstring>
+# include  <sys/types.h>
+# include  <sys/ioctl.h>
+# include  <sys/mman.h>
+# include  <fcntl.h>
+# include  <unistd.h>
+
+const char*slf_user_in::name(unsigned idx)
+{
+      static const char*names[COUNT] = {
+	    "PB0", "PB1", "PB2", "PB3",
+	    "DIP_SW0", "DIP_SW1", "DIP_SW2", "DIP_SW3"
+      };
+      return idx < COUNT? names[idx] : "?";
+}
+
+const char*slf_device::default_path()
+{
+      const char*path = getenv("SLF_FPGA_DEVICE");
+      return path? path : "/dev/slf_fpga0";
+}
+
+slf_device::slf_device(const char*path, int flags)
+: error_(0)
+{
+      if (path == 0)
+	    path = default_path();
+      if (flags < 0)
+	    flags = O_RDWR;
+
+      fd_ = open(path, flags|O_CLOEXEC, 0);
+      if (fd_ < 0)
+	    error_ = -errno;
+}
+
+slf_device::~slf_device()
+{
+      close_();
+}
+
+slf_device::slf_device(slf_device&&that)
+: fd_(that.fd_), error_(that.error_)
+{
+      that.fd_ = -1;
+      that.error_ = -EBADF;
+}
+
+slf_device& slf_device::operator= (slf_device&&that)
+{
+      if (this != &that) {
+	    close_();
+	    fd_ = that.fd_;
+	    error_ = that.error_;
+	    that.fd_ = -1;
+	    that.error_ = -EBADF;
+      }
+      return *this;
+}
+
+void slf_device::close_()
+{
+      if (fd_ >= 0) {
+	    close(fd_);
+	    fd_ = -1;
+      }
+}
+
+int slf_device::leds(const slf_leds&val)
+{
+      struct slf_fpga_leds_s arg;
+      arg.led_value = val.raw();
+      if (ioctl(fd_, SLF_FPGA_LEDS, &arg) < 0)
+	    return -errno;
+      return 0;
+}
+
+int slf_device::read_leds(slf_leds&val) const
+{
+      struct slf_fpga_batch_op_s op;
+      op.op = SLF_FPGA_BATCH_READ;
+      op.address = slf_fpga_regs::ADDR_LEDs;
+      op.mask = 0xffffffff;
+      op.value = 0;
+
+      struct slf_fpga_batch_s arg;
+      arg.ops = (uintptr_t)&op;
+      arg.count = 1;
+      arg.reserved = 0;
+      if (ioctl(fd_, SLF_FPGA_BATCH, &arg) < 0)
+	    return -errno;
+
+      val = slf_leds(op.value);
+      return 0;
+}
+
+int slf_device::read_user_in(slf_user_in&val) const
+{
+      struct slf_fpga_UserIn_s arg;
+      if (ioctl(fd_, SLF_FPGA_UserIn, &arg) < 0)
+	    return -errno;
+      val = slf_user_in(arg.user_in_value);
+      return 0;
+}
+
+int slf_device::snapshot(struct slf_fpga_snapshot_s&val) const
+{
+      if (ioctl(fd_, SLF_FPGA_SNAPSHOT, &val) < 0)
+	    return -errno;
+      return 0;
+}
+
+int slf_device::update_leds(const slf_leds&val, uint32_t mask)
+{
+      struct slf_fpga_batch_op_s op;
+      op.op = SLF_FPGA_BATCH_MODIFY;
+      op.address = slf_fpga_regs::ADDR_LEDs;
+      op.mask = mask;
+      op.value = val.raw();
+      return batch(&op, 1);
+}
+
+int slf_device::batch(struct slf_fpga_batch_op_s*ops, size_t count)
+{
+      struct slf_fpga_batch_s arg;
+      arg.ops = (uintptr_t)ops;
+      arg.count = count;
+      arg.reserved = 0;
+      if (ioctl(fd_, SLF_FPGA_BATCH, &arg) < 0)
+	    return -errno;
+      return 0;
+}
+
+int slf_device::irq_moderate(uint32_t holdoff_clocks, uint32_t event_count)
+{
+      struct slf_fpga_irq_moderate_s arg;
+      arg.holdoff_clocks = holdoff_clocks;
+      arg.event_count = event_count;
+      if (ioctl(fd_, SLF_FPGA_IRQ_MODERATE, &arg) < 0)
+	    return -errno;
+      return 0;
+}
+
+int slf_device::seq_load(const slf_leds*frames, size_t count,
+			 uint32_t period_clocks, uint32_t flags)
+{
+      if (count > SLF_FPGA_SEQ_FRAMES)
+	    return -EINVAL;
+
+      uint32_t raw[SLF_FPGA_SEQ_FRAMES];
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    raw[idx] = frames[idx].raw();
+
+      struct slf_fpga_seq_load_s arg;
+      arg.frames = (uintptr_t)raw;
+      arg.count = count;
+      arg.period_clocks = period_clocks;
+      arg.flags = flags;
+      arg.reserved = 0;
+      if (ioctl(fd_, SLF_FPGA_SEQ_LOAD, &arg) < 0)
+	    return -errno;
+      return 0;
+}
+
+int slf_device::seq_control(uint32_t flags)
+{
+      struct slf_fpga_seq_control_s arg;
+      arg.flags = flags;
+      arg.frame = 0;
+      if (ioctl(fd_, SLF_FPGA_SEQ_CONTROL, &arg) < 0)
+	    return -errno;
+      return 0;
+}
+
+int slf_device::leds_wide(const uint8_t levels[8], uint32_t flags)
+{
+      struct slf_fpga_leds_wide_s arg;
+      memcpy(arg.level, levels, sizeof arg.level);
+      arg.flags = flags;
+      arg.reserved = 0;
+      if (ioctl(fd_, SLF_FPGA_LEDS_WIDE, &arg) < 0)
+	    return -errno;
+      return 0;
+}
+
+int slf_device::debounce(uint32_t&filter_ns, uint32_t fast_mask)
+{
+      struct slf_fpga_debounce_s arg;
+      arg.filter_ns = filter_ns;
+      arg.fast_mask = fast_mask;
+      if (ioctl(fd_, SLF_FPGA_DEBOUNCE, &arg) < 0)
+	    return -errno;
+      filter_ns = arg.filter_ns;
+      return 0;
+}
+
+slf_snapshot_map::slf_snapshot_map(const slf_device&dev)
+: snap_(0)
+{
+      void*ptr = mmap(0, sizeof(struct slf_fpga_snapshot_s), PROT_READ, MAP_SHARED,
+		      dev.fd(), SLF_FPGA_MMAP_SNAPSHOT);
+      if (ptr != MAP_FAILED)
+	    snap_ = (const volatile struct slf_fpga_snapshot_s*)ptr;
+}
+
+slf_snapshot_map::~slf_snapshot_map()
+{
+      if (snap_) munmap((void*)snap_, sizeof(struct slf_fpga_snapshot_s));
+}
+
+/*
+ * This is the reader side of the seqlock that the driver uses to
+ * update the snapshot. See SLF_FPGA_MMAP_SNAPSHOT in slf_fpga.h.
+ */
+void slf_snapshot_map::read(struct slf_fpga_snapshot_s&val) const
+{
+      for (;;) {
+	    uint32_t seq = __atomic_load_n(&snap_->seq, __ATOMIC_ACQUIRE);
+	    if (seq & 1)
+		  continue;
+
+	    val.user_in = snap_->user_in;
+	    val.event_seq = snap_->event_seq;
+	    val.timestamp_ns = snap_->timestamp_ns;
+	    for (size_t idx = 0 ; idx < sizeof val.bit_changes / sizeof val.bit_changes[0] ; idx += 1)
+		  val.bit_changes[idx] = snap_->bit_changes[idx];
+
+	    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+	    if (snap_->seq == seq) {
+		  val.seq = seq;
+		  return;
+	    }
+      }
+}
+
+slf_user_in slf_snapshot_map::user_in() const
+{
+	// A single aligned word can't tear, so there is no need for
+	// the retry loop here.
+      return slf_user_in(snap_->user_in);
+}
+
+int slf_led_batch::commit(slf_device&dev)
+{
+      if (mask_ == 0)
+	    return 0;
+
+      int rc = dev.update_leds(value_, mask_);
+      value_ = slf_leds();
+      mask_ = 0;
+      return rc;
+}
+
+slf_event_source::slf_event_source(const char*path)
+: dev_(path, O_RDONLY|O_NONBLOCK)
+{
+}
+
+int slf_event_source::read(slf_input_event*buf, size_t count)
+{
+      struct slf_fpga_event_s raw[64];
+      if (count > sizeof raw / sizeof raw[0])
+	    count = sizeof raw / sizeof raw[0];
+
+      ssize_t rc = ::read(dev_.fd(), raw, count * sizeof raw[0]);
+      if (rc < 0)
+	    return errno == EAGAIN? 0 : -errno;
+
+      size_t nevents = rc / sizeof raw[0];
+      for (size_t idx = 0 ; idx < nevents ; idx += 1) {
+	    buf[idx].timestamp_ns = raw[idx].timestamp_ns;
+	    buf[idx].old_value = slf_user_in(raw[idx].user_in_old);
+	    buf[idx].new_value = slf_user_in(raw[idx].user_in_new);
+      }
+      return nevents;
+}
+
+int slf_event_source::stats(struct slf_fpga_event_stats_s&val) const
+{
+      if (ioctl(dev_.fd(), SLF_FPGA_EVENT_STATS, &val) < 0)
+	    return -errno;
+      return 0;
+}
@@ -0,0 +1,289 @@
+#ifndef __libslf_H
+#define __libslf_H
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * libslf is a C++ wrapper around the slf_fpga device interface. It
+ * takes care of opening the device, and has value types for the LED
+ * and user input registers, so that applications don't need to know
+ * the bit layouts. Errors are reported by returning -errno, the same
+ * as the system calls underneath.
+ *
+ * Input changes are delivered through slf_event_source, which is
+ * non-blocking. Put its fd() in a poll/epoll/io_uring set along with
+ * the other fds of the application, and call dispatch() when it is
+ * readable. No thread needs to block waiting on the device.
+ */
+# include  "slf_fpga.h"
+# include  <cstddef>
+# include  <cstdint>
+
+/*
+ * The brightness of the 8 LEDs, each 0 (off) to 15 (full on). This is
+ * the format of the LEDs register.
+ */
+class slf_leds {
+
+    public:
+      static const unsigned COUNT = 8;
+      static const unsigned LEVEL_MAX = 15;
+
+      slf_leds() : raw_(0) { }
+      explicit slf_leds(uint32_t raw) : raw_(raw) { }
+
+	// Get/set the brightness of one LED. Levels above LEVEL_MAX
+	// are clipped.
+      unsigned level(unsigned idx) const { return (raw_ >> (4*idx)) & 0xf; }
+      slf_leds& level(unsigned idx, unsigned val)
+      {
+	    if (val > LEVEL_MAX) val = LEVEL_MAX;
+	    raw_ = (raw_ & ~field_mask(idx)) | (val << (4*idx));
+	    return *this;
+      }
+
+	// The register bits of one LED.
+      static uint32_t field_mask(unsigned idx) { return 0xfU << (4*idx); }
+
+      uint32_t raw() const { return raw_; }
+
+      bool operator == (const slf_leds&that) const { return raw_ == that.raw_; }
+      bool operator != (const slf_leds&that) const { return raw_ != that.raw_; }
+
+    private:
+      uint32_t raw_;
+};
+
+/*
+ * The state of the user inputs: 4 push buttons and 4 DIP switches.
+ * This is the format of the UserIn register.
+ */
+class slf_user_in {
+
+    public:
+      static const unsigned COUNT = 8;
+      static const unsigned PB_COUNT = 4;
+      static const unsigned DIP_SW_COUNT = 4;
+
+      slf_user_in() : raw_(0) { }
+      explicit slf_user_in(uint32_t raw) : raw_(raw & 0xff) { }
+
+      bool pb(unsigned idx) const     { return bit(idx); }
+      bool dip_sw(unsigned idx) const { return bit(PB_COUNT + idx); }
+
+	// Access the inputs by bit number, 0..COUNT-1.
+      bool bit(unsigned idx) const { return (raw_ >> idx) & 1; }
+
+	// The name of the input at this bit number, i.e. "PB0".
+      static const char*name(unsigned idx);
+
+      uint32_t raw() const { return raw_; }
+
+      bool operator == (const slf_user_in&that) const { return raw_ == that.raw_; }
+      bool operator != (const slf_user_in&that) const { return raw_ != that.raw_; }
+
+    private:
+      uint32_t raw_;
+};
+
+/*
+ * One change of the user inputs.
+ */
+struct slf_input_event {
+      uint64_t timestamp_ns;
+      slf_user_in old_value;
+      slf_user_in new_value;
+
+	// The inputs that changed, as a bit mask.
+      uint32_t changed() const { return old_value.raw() ^ new_value.raw(); }
+};
+
+/*
+ * An open slf_fpga device. This owns the file descriptor, and closes
+ * it when destroyed. It can be moved, but not copied.
+ */
+class slf_device {
+
+    public:
+	// The path of the device with this minor number. The default
+	// device (minor 0) can be overridden with the SLF_FPGA_DEVICE
+	// environment variable.
+      static const char*default_path();
+
+	// Open the device at the path, or the default device if the
+	// path is nil. Check is_open() or error() to see if it
+	// worked. The flags are passed to open(2).
+      explicit slf_device(const char*path =0, int flags =-1);
+      ~slf_device();
+
+      slf_device(slf_device&&that);
+      slf_device& operator= (slf_device&&that);
+
+      bool is_open() const { return fd_ >= 0; }
+	// The -errno from the open, or 0.
+      int error() const { return error_; }
+      int fd() const { return fd_; }
+
+      int leds(const slf_leds&val);
+      int read_leds(slf_leds&val) const;
+      int read_user_in(slf_user_in&val) const;
+	// Get a consistent copy of the driver's input snapshot.
+      int snapshot(struct slf_fpga_snapshot_s&val) const;
+
+	// Change only the selected LEDs, without disturbing others
+	// that another thread or process may be changing. The mask is
+	// register bits, i.e. from slf_leds::field_mask().
+      int update_leds(const slf_leds&val, uint32_t mask);
+
+	// Run a sequence of register operations atomically. See the
+	// SLF_FPGA_BATCH ioctl.
+      int batch(struct slf_fpga_batch_op_s*ops, size_t count);
+
+      int irq_moderate(uint32_t holdoff_clocks, uint32_t event_count);
+
+	// Load a sequence of LED frames into the hardware sequencer,
+	// which then plays them with no further help from software.
+	// The flags are SLF_FPGA_SEQ_RUN and/or SLF_FPGA_SEQ_LOOP.
+      int seq_load(const slf_leds*frames, size_t count,
+		   uint32_t period_clocks, uint32_t flags);
+      int seq_control(uint32_t flags);
+
+	// Set the 8 LEDs to 8-bit levels (0-255). The flags may be
+	// SLF_FPGA_LED_GAMMA to gamma correct the levels.
+      int leds_wide(const uint8_t levels[8], uint32_t flags =0);
+
+	// Set the debounce filter time, and the inputs (a mask of
+	// slf_user_in bits) that report the first edge right away.
+	// Returns the filter time actually in effect through filter_ns.
+      int debounce(uint32_t&filter_ns, uint32_t fast_mask =0);
+
+    private:
+      void close_();
+
+    private:
+      int fd_;
+      int error_;
+
+    private: // not implemented
+      slf_device(const slf_device&);
+      slf_device& operator= (const slf_device&);
+};
+
+/*
+ * A read-only mapping of the driver's input snapshot. Reading through
+ * the mapping takes no system call and no bus access, so it suits
+ * threads that poll the inputs. The device must stay open while the
+ * mapping is in use.
+ */
+class slf_snapshot_map {
+
+    public:
+      explicit slf_snapshot_map(const slf_device&dev);
+      ~slf_snapshot_map();
+
+      bool is_mapped() const { return snap_ != 0; }
+
+	// Get a consistent copy of the snapshot. This retries if the
+	// driver is in the middle of an update.
+      void read(struct slf_fpga_snapshot_s&val) const;
+
+      slf_user_in user_in() const;
+
+    private:
+      const volatile struct slf_fpga_snapshot_s*snap_;
+
+    private: // not implemented
+      slf_snapshot_map(const slf_snapshot_map&);
+      slf_snapshot_map& operator= (const slf_snapshot_map&);
+};
+
+/*
+ * Collect changes to the LEDs, and apply them all at once with a
+ * single system call. Only the LEDs that were set are changed.
+ */
+class slf_led_batch {
+
+    public:
+      slf_led_batch() : mask_(0) { }
+
+      slf_led_batch& set(unsigned idx, unsigned level)
+      {
+	    value_.level(idx, level);
+	    mask_ |= slf_leds::field_mask(idx);
+	    return *this;
+      }
+
+      bool empty() const { return mask_ == 0; }
+
+	// Apply the changes to the device, and clear the batch.
+      int commit(slf_device&dev);
+
+    private:
+      slf_leds value_;
+      uint32_t mask_;
+};
+
+/*
+ * A non-blocking source of input change events. This opens its own
+ * file on the device, so it has its own position in the event stream
+ * and sees every change that happens after it is created.
+ */
+class slf_event_source {
+
+    public:
+      explicit slf_event_source(const char*path =0);
+
+      bool is_open() const { return dev_.is_open(); }
+      int error() const { return dev_.error(); }
+
+	// The fd is readable when there are events.
+      int fd() const { return dev_.fd(); }
+
+	// Read up to count events into the buffer, without blocking.
+	// Return the number of events read (0 if there are none) or
+	// -errno.
+      int read(slf_input_event*buf, size_t count);
+
+	// Read all the pending events, and call fn for each. Return
+	// the number of events dispatched, or -errno.
+      template <class FUN> int dispatch(FUN fn);
+
+      int stats(struct slf_fpga_event_stats_s&val) const;
+
+    private:
+      slf_device dev_;
+};
+
+template <class FUN> int slf_event_source::dispatch(FUN fn)
+{
+      int total = 0;
+      for (;;) {
+	    slf_input_event buf[64];
+	    int rc = read(buf, sizeof buf / sizeof buf[0]);
+	    if (rc < 0)
+		  return total? total : rc;
+	    for (int idx = 0 ; idx < rc ; idx += 1)
+		  fn(buf[idx]);
+	    total += rc;
+	    if (rc < (int)(sizeof buf / sizeof buf[0]))
+		  return total;
+      }
+}
+
+#endif
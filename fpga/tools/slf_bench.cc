@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * slf_bench is a stress benchmark for the slf_fpga driver. For each
+ * thread count in the list, it runs that many worker threads that
+ * hammer the LEDS and UserIn ioctls, alongside a set of threads that
+ * sit in SLF_FPGA_WAIT. It reports the ioctl rate and latency
+ * percentiles for each step, and how many waiters each input change
+ * woke up, so that scalability regressions and races show up before
+ * a new driver is deployed.
+ *
+ *   slf_bench [--path=<dev>] [--threads=<n>[,<n>...]] [--waiters=<n>]
+ *             [--seconds=<n>] [--op=leds|userin|mixed] [--shared-fd]
+ *
+ * Each thread opens the device for itself, unless --shared-fd is
+ * given, and the threads are spread across the CPUs. The waiters only
+ * wake up if the inputs change during the run, so press some buttons
+ * (or run against the simulation) to measure the wakeup fan-out.
+ */
+
+# include  "libslf.h"
+# include  <algorithm>
+# include  <atomic>
+# include  <map>
+# include  <thread>
+# include  <vector>
+# include  <cerrno>
+# include  <csignal>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <ctime>
+# include  <pthread.h>
+# include  <sched.h>
+# include  <sys/ioctl.h>
+# include  <unistd.h>
+
+enum bench_op_t { OP_LEDS, OP_USERIN, OP_MIXED };
+
+// Keep at most this many latency samples per worker per step.
+static const size_t SAMPLES_MAX = 1 << 20;
+
+static std::atomic<bool> stop_flag;
+static std::atomic<unsigned> waiters_done;
+
+static uint64_t monotonic_ns(void)
+{
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void pin_to_cpu(std::thread&thr, unsigned idx)
+{
+      long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+      if (ncpu <= 0)
+	    return;
+
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(idx % ncpu, &set);
+      pthread_setaffinity_np(thr.native_handle(), sizeof set, &set);
+}
+
+struct worker_result {
+      uint64_t ops;
+      uint64_t errors;
+      std::vector<uint32_t> latency_ns;
+};
+
+static void worker(slf_device*dev, unsigned idx, bench_op_t op, worker_result*res)
+{
+      res->ops = 0;
+      res->errors = 0;
+      res->latency_ns.reserve(SAMPLES_MAX);
+
+      uint32_t leds = idx;
+      while (! stop_flag.load(std::memory_order_relaxed)) {
+	    bool use_leds = op == OP_LEDS || (op == OP_MIXED && (res->ops & 1));
+
+	    uint64_t start = monotonic_ns();
+	    int rc;
+	    if (use_leds) {
+		  rc = dev->leds(slf_leds(leds++));
+	    } else {
+		  slf_user_in val;
+		  rc = dev->read_user_in(val);
+	    }
+	    uint64_t end = monotonic_ns();
+
+	    if (rc < 0)
+		  res->errors += 1;
+	    res->ops += 1;
+	    if (res->latency_ns.size() < SAMPLES_MAX) {
+		  uint64_t delta = end - start;
+		  res->latency_ns.push_back(delta > UINT32_MAX? UINT32_MAX : delta);
+	    }
+      }
+}
+
+struct waiter_wake {
+      uint64_t event_seq;
+      uint64_t latency_ns;
+};
+
+struct waiter_result {
+      uint64_t wakes;
+      std::vector<waiter_wake> wake_list;
+};
+
+/*
+ * Sit in SLF_FPGA_WAIT until the inputs change, then note which
+ * change it was (from the snapshot) and how long after the change
+ * this thread got to run. The main thread sends a signal to break
+ * the waiters out at the end of the step.
+ */
+static void waiter(slf_device*dev, waiter_result*res)
+{
+      res->wakes = 0;
+
+      slf_user_in cur;
+      int rc = dev->read_user_in(cur);
+
+      while (rc == 0 && ! stop_flag.load(std::memory_order_relaxed)) {
+	    struct slf_fpga_wait_s arg;
+	    arg.user_in_exp = cur.raw();
+	    arg.timeout_ms = 0;
+	    uint64_t now;
+	    if (ioctl(dev->fd(), SLF_FPGA_WAIT, &arg) < 0)
+		  continue;
+	    now = monotonic_ns();
+
+	    cur = slf_user_in(arg.user_in_value);
+	    res->wakes += 1;
+
+	    struct slf_fpga_snapshot_s snap;
+	    if (dev->snapshot(snap) == 0) {
+		  waiter_wake wake;
+		  wake.event_seq = snap.event_seq;
+		  wake.latency_ns = now > snap.timestamp_ns? now - snap.timestamp_ns : 0;
+		  res->wake_list.push_back(wake);
+	    }
+      }
+
+      waiters_done += 1;
+}
+
+static void wake_handler(int)
+{
+}
+
+template <class T> static T percentile(const std::vector<T>&sorted, double pct)
+{
+      if (sorted.empty())
+	    return 0;
+      size_t pos = (size_t)(pct / 100.0 * (sorted.size() - 1) + 0.5);
+      return sorted[pos];
+}
+
+static int run_step(const char*dev_path, unsigned nthreads, unsigned nwaiters,
+		    unsigned seconds, bench_op_t op, bool shared_fd)
+{
+	// Open all the devices up front, so that the opens are not
+	// part of the measurement.
+      std::vector<slf_device> devs;
+      unsigned ndevs = shared_fd? 1 : nthreads + nwaiters;
+      for (unsigned idx = 0 ; idx < ndevs ; idx += 1) {
+	    devs.push_back(slf_device(dev_path));
+	    if (! devs.back().is_open()) {
+		  fprintf(stderr, "%s: Unable to open device: %s\n", dev_path,
+			  strerror(-devs.back().error()));
+		  return 1;
+	    }
+      }
+
+      stop_flag = false;
+      waiters_done = 0;
+
+      std::vector<worker_result> wres (nthreads);
+      std::vector<waiter_result> wtres (nwaiters);
+      std::vector<std::thread> threads;
+
+      for (unsigned idx = 0 ; idx < nwaiters ; idx += 1) {
+	    slf_device*dev = &devs[shared_fd? 0 : nthreads + idx];
+	    threads.push_back(std::thread(waiter, dev, &wtres[idx]));
+	    pin_to_cpu(threads.back(), nthreads + idx);
+      }
+
+      uint64_t start = monotonic_ns();
+      for (unsigned idx = 0 ; idx < nthreads ; idx += 1) {
+	    slf_device*dev = &devs[shared_fd? 0 : idx];
+	    threads.push_back(std::thread(worker, dev, idx, op, &wres[idx]));
+	    pin_to_cpu(threads.back(), idx);
+      }
+
+      sleep(seconds);
+      stop_flag = true;
+
+      for (unsigned idx = nwaiters ; idx < threads.size() ; idx += 1)
+	    threads[idx].join();
+      uint64_t elapsed = monotonic_ns() - start;
+
+	// Kick the waiters out of their ioctls. They check the stop
+	// flag when the ioctl fails, but the signal may land just
+	// before a waiter enters the ioctl, so keep kicking until
+	// they are all done.
+      while (waiters_done.load() < nwaiters) {
+	    for (unsigned idx = 0 ; idx < nwaiters ; idx += 1)
+		  pthread_kill(threads[idx].native_handle(), SIGUSR1);
+	    usleep(10000);
+      }
+      for (unsigned idx = 0 ; idx < nwaiters ; idx += 1)
+	    threads[idx].join();
+
+      uint64_t ops = 0, errors = 0;
+      std::vector<uint32_t> lat;
+      for (unsigned idx = 0 ; idx < nthreads ; idx += 1) {
+	    ops += wres[idx].ops;
+	    errors += wres[idx].errors;
+	    lat.insert(lat.end(), wres[idx].latency_ns.begin(), wres[idx].latency_ns.end());
+      }
+      std::sort(lat.begin(), lat.end());
+
+      printf("%7u %12.0f %10u %10u %10u %10u %8llu",
+	     nthreads, ops / (elapsed / 1e9),
+	     percentile(lat, 50.0), percentile(lat, 99.0),
+	     percentile(lat, 99.9), lat.empty()? 0 : lat.back(),
+	     (unsigned long long)errors);
+
+	// The fan-out is the number of waiters woken for each input
+	// change, and the wake latency is from the change to the
+	// waiter running.
+      std::map<uint64_t,unsigned> fanout;
+      std::vector<uint64_t> wake_lat;
+      uint64_t wakes = 0;
+      for (unsigned idx = 0 ; idx < nwaiters ; idx += 1) {
+	    wakes += wtres[idx].wakes;
+	    for (size_t wdx = 0 ; wdx < wtres[idx].wake_list.size() ; wdx += 1) {
+		  fanout[wtres[idx].wake_list[wdx].event_seq] += 1;
+		  wake_lat.push_back(wtres[idx].wake_list[wdx].latency_ns);
+	    }
+      }
+      std::sort(wake_lat.begin(), wake_lat.end());
+
+      if (nwaiters == 0) {
+	    printf("\n");
+      } else {
+	    printf(" %8llu %8zu %7.2f %10llu %10llu\n",
+		   (unsigned long long)wakes, fanout.size(),
+		   fanout.empty()? 0.0 : (double)wake_lat.size() / fanout.size(),
+		   (unsigned long long)percentile(wake_lat, 50.0),
+		   (unsigned long long)percentile(wake_lat, 99.0));
+      }
+      fflush(stdout);
+
+      return 0;
+}
+
+int main(int argc, char*argv[])
+{
+      const char*dev_path = slf_device::default_path();
+      const char*thread_list = "1,2,4,8";
+      unsigned nwaiters = 4;
+      unsigned seconds = 2;
+      bench_op_t op = OP_MIXED;
+      bool shared_fd = false;
+
+      for (int arg_idx = 1 ; arg_idx < argc ; arg_idx += 1) {
+	    if (strncmp(argv[arg_idx],"--path=",7) == 0) {
+		  dev_path = argv[arg_idx]+7;
+
+	    } else if (strncmp(argv[arg_idx],"--threads=",10) == 0) {
+		  thread_list = argv[arg_idx]+10;
+
+	    } else if (strncmp(argv[arg_idx],"--waiters=",10) == 0) {
+		  nwaiters = strtoul(argv[arg_idx]+10,0,0);
+
+	    } else if (strncmp(argv[arg_idx],"--seconds=",10) == 0) {
+		  seconds = strtoul(argv[arg_idx]+10,0,0);
+
+	    } else if (strcmp(argv[arg_idx],"--op=leds") == 0) {
+		  op = OP_LEDS;
+
+	    } else if (strcmp(argv[arg_idx],"--op=userin") == 0) {
+		  op = OP_USERIN;
+
+	    } else if (strcmp(argv[arg_idx],"--op=mixed") == 0) {
+		  op = OP_MIXED;
+
+	    } else if (strcmp(argv[arg_idx],"--shared-fd") == 0) {
+		  shared_fd = true;
+
+	    } else {
+		  fprintf(stderr, "Unknown argument: %s\n", argv[arg_idx]);
+		  return 2;
+	    }
+      }
+
+      if (seconds == 0)
+	    seconds = 1;
+
+	// The signal only needs to interrupt the waiters' ioctls, so
+	// the handler does nothing, and there is no SA_RESTART.
+      struct sigaction sa;
+      memset(&sa, 0, sizeof sa);
+      sa.sa_handler = wake_handler;
+      sigaction(SIGUSR1, &sa, 0);
+
+      printf("%7s %12s %10s %10s %10s %10s %8s", "threads", "ops/sec",
+	     "p50(ns)", "p99(ns)", "p99.9(ns)", "max(ns)", "errors");
+      if (nwaiters > 0)
+	    printf(" %8s %8s %7s %10s %10s", "wakes", "changes", "fanout",
+		   "wake-p50", "wake-p99");
+      printf("\n");
+
+      const char*cp = thread_list;
+      while (*cp) {
+	    char*ep;
+	    unsigned nthreads = strtoul(cp, &ep, 0);
+	    if (ep == cp || nthreads == 0) {
+		  fprintf(stderr, "Bad thread count list: %s\n", thread_list);
+		  return 2;
+	    }
+
+	    int rc = run_step(dev_path, nthreads, nwaiters, seconds, op, shared_fd);
+	    if (rc != 0)
+		  return rc;
+
+	    cp = *ep == ','? ep+1 : ep;
+      }
+
+      return 0;
+}
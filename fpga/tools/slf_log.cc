@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * slf_log records the user input events from the slf_fpga device into
+ * a compact binary file, and summarizes such files. To record:
+ *
+ *   slf_log --output=<file> [--path=<dev>] [--seconds=<n>] [--buffer-kb=<n>]
+ *
+ * This runs until the time is up, or until interrupted. To summarize:
+ *
+ *   slf_log --summary=<file>
+ *
+ * The file is a struct slf_log_header followed by struct slf_log_record
+ * entries, all in the native byte order of the recording machine.
+ * Records are collected in a large buffer and written a buffer at a
+ * time, so logging does not add a system call per event.
+ */
+
+# include  "libslf.h"
+# include  <algorithm>
+# include  <vector>
+# include  <cerrno>
+# include  <csignal>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <ctime>
+# include  <poll.h>
+# include  <sys/mman.h>
+# include  <sys/stat.h>
+# include  <fcntl.h>
+# include  <unistd.h>
+
+static const char SLF_LOG_MAGIC[8] = { 'S','L','F','L','O','G','0','1' };
+
+struct slf_log_header {
+      char     magic[8];
+      uint32_t record_size;
+      uint32_t reserved;
+	// CLOCK_MONOTONIC time that the recording started.
+      uint64_t start_ns;
+};
+
+struct slf_log_record {
+	// CLOCK_MONOTONIC time that the driver saw the change.
+      uint64_t timestamp_ns;
+	// Time from timestamp_ns until slf_log was awake to read it.
+      uint32_t wake_ns;
+      uint8_t  user_in_old;
+      uint8_t  user_in_new;
+      uint16_t reserved;
+};
+
+static uint64_t monotonic_ns(void)
+{
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Collect records into a large buffer, and write the buffer to the
+ * file when it fills up.
+ */
+class slf_log_writer {
+
+    public:
+      slf_log_writer(int fd, size_t buffer_records)
+      : fd_(fd), buf_(buffer_records), fill_(0), error_(0) { }
+
+      void add(const slf_log_record&rec)
+      {
+	    buf_[fill_++] = rec;
+	    if (fill_ == buf_.size())
+		  flush();
+      }
+
+      int flush()
+      {
+	    const char*ptr = (const char*)&buf_[0];
+	    size_t len = fill_ * sizeof buf_[0];
+	    while (len > 0) {
+		  ssize_t rc = write(fd_, ptr, len);
+		  if (rc < 0 && errno == EINTR)
+			continue;
+		  if (rc < 0) {
+			error_ = -errno;
+			break;
+		  }
+		  ptr += rc;
+		  len -= rc;
+	    }
+	    fill_ = 0;
+	    return error_;
+      }
+
+      int error() const { return error_; }
+
+    private:
+      int fd_;
+      std::vector<slf_log_record> buf_;
+      size_t fill_;
+      int error_;
+
+    private: // not implemented
+      slf_log_writer(const slf_log_writer&);
+      slf_log_writer& operator= (const slf_log_writer&);
+};
+
+static volatile sig_atomic_t stop_flag = 0;
+
+static void stop_handler(int)
+{
+      stop_flag = 1;
+}
+
+static int do_record(const char*dev_path, const char*out_path,
+		     unsigned seconds, size_t buffer_kb)
+{
+      slf_event_source events (dev_path);
+      if (! events.is_open()) {
+	    fprintf(stderr, "%s: Unable to open device: %s\n", dev_path, strerror(-events.error()));
+	    return 1;
+      }
+
+      int fd = open(out_path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+      if (fd < 0) {
+	    fprintf(stderr, "%s: Unable to create: %s\n", out_path, strerror(errno));
+	    return 1;
+      }
+
+      struct slf_log_header header;
+      memset(&header, 0, sizeof header);
+      memcpy(header.magic, SLF_LOG_MAGIC, sizeof header.magic);
+      header.record_size = sizeof(slf_log_record);
+      header.start_ns = monotonic_ns();
+      if (write(fd, &header, sizeof header) != (ssize_t)sizeof header) {
+	    fprintf(stderr, "%s: Unable to write header: %s\n", out_path, strerror(errno));
+	    close(fd);
+	    return 1;
+      }
+
+      size_t buffer_records = buffer_kb * 1024 / sizeof(slf_log_record);
+      if (buffer_records == 0)
+	    buffer_records = 1;
+      slf_log_writer writer (fd, buffer_records);
+
+      struct sigaction sa;
+      memset(&sa, 0, sizeof sa);
+      sa.sa_handler = stop_handler;
+      sigaction(SIGINT, &sa, 0);
+      sigaction(SIGTERM, &sa, 0);
+
+      uint64_t end_ns = seconds? header.start_ns + seconds * 1000000000ULL : 0;
+      uint64_t total = 0;
+
+      struct pollfd fds[1];
+      fds[0].fd = events.fd();
+      fds[0].events = POLLIN;
+
+      while (! stop_flag && writer.error() == 0) {
+	    int timeout_ms = -1;
+	    if (end_ns) {
+		  uint64_t now = monotonic_ns();
+		  if (now >= end_ns)
+			break;
+		  timeout_ms = (end_ns - now + 999999) / 1000000;
+	    }
+
+	    int rc = poll(fds, 1, timeout_ms);
+	    if (rc < 0 && errno == EINTR)
+		  continue;
+	    if (rc < 0) {
+		  fprintf(stderr, "%s: poll: %s\n", dev_path, strerror(errno));
+		  break;
+	    }
+	    if (! (fds[0].revents & POLLIN))
+		  continue;
+
+	      // Take the time once per wakeup, so that the wake time
+	      // is the time that this process got to run.
+	    uint64_t wake = monotonic_ns();
+	    rc = events.dispatch([&](const slf_input_event&evt) {
+		  slf_log_record rec;
+		  rec.timestamp_ns = evt.timestamp_ns;
+		  uint64_t delta = wake > evt.timestamp_ns? wake - evt.timestamp_ns : 0;
+		  rec.wake_ns = delta > UINT32_MAX? UINT32_MAX : delta;
+		  rec.user_in_old = evt.old_value.raw();
+		  rec.user_in_new = evt.new_value.raw();
+		  rec.reserved = 0;
+		  writer.add(rec);
+	    });
+	    if (rc < 0) {
+		  fprintf(stderr, "%s: read: %s\n", dev_path, strerror(-rc));
+		  break;
+	    }
+	    total += rc;
+      }
+
+      int rc = writer.flush();
+      close(fd);
+      if (rc < 0) {
+	    fprintf(stderr, "%s: write: %s\n", out_path, strerror(-rc));
+	    return 1;
+      }
+
+      struct slf_fpga_event_stats_s stats;
+      if (events.stats(stats) == 0)
+	    fprintf(stderr, "%s: %llu events logged, %u dropped, %u FIFO overflows\n",
+		    out_path, (unsigned long long)total, stats.events_dropped,
+		    stats.fifo_overflows);
+
+      return 0;
+}
+
+/*
+ * Print the percentiles of the values, which are sorted in place.
+ */
+static void print_percentiles(const char*label, std::vector<uint64_t>&vals)
+{
+      if (vals.empty()) {
+	    printf("%-16s: (none)\n", label);
+	    return;
+      }
+
+      std::sort(vals.begin(), vals.end());
+      uint64_t sum = 0;
+      for (size_t idx = 0 ; idx < vals.size() ; idx += 1)
+	    sum += vals[idx];
+
+      static const double pct[] = { 50.0, 90.0, 99.0, 99.9 };
+      printf("%-16s: min=%llu mean=%llu", label,
+	     (unsigned long long)vals.front(),
+	     (unsigned long long)(sum / vals.size()));
+      for (size_t idx = 0 ; idx < sizeof pct / sizeof pct[0] ; idx += 1) {
+	    size_t pos = (size_t)(pct[idx] / 100.0 * (vals.size() - 1) + 0.5);
+	    printf(" p%g=%llu", pct[idx], (unsigned long long)vals[pos]);
+      }
+      printf(" max=%llu (ns)\n", (unsigned long long)vals.back());
+}
+
+static int do_summary(const char*path)
+{
+      int fd = open(path, O_RDONLY);
+      if (fd < 0) {
+	    fprintf(stderr, "%s: Unable to open: %s\n", path, strerror(errno));
+	    return 1;
+      }
+
+      struct stat st;
+      if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(slf_log_header)) {
+	    fprintf(stderr, "%s: Not a slf_log file\n", path);
+	    close(fd);
+	    return 1;
+      }
+
+	// Map the whole file, rather than read it, since it may be
+	// large and is only scanned.
+      void*map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED) {
+	    fprintf(stderr, "%s: Unable to map: %s\n", path, strerror(errno));
+	    return 1;
+      }
+
+      const slf_log_header*header = (const slf_log_header*)map;
+      if (memcmp(header->magic, SLF_LOG_MAGIC, sizeof header->magic) != 0
+	  || header->record_size != sizeof(slf_log_record)) {
+	    fprintf(stderr, "%s: Not a slf_log file\n", path);
+	    munmap(map, st.st_size);
+	    return 1;
+      }
+
+      const slf_log_record*recs = (const slf_log_record*)(header + 1);
+      size_t nrecs = (st.st_size - sizeof *header) / sizeof *recs;
+
+      std::vector<uint64_t> intervals;
+      std::vector<uint64_t> wakes;
+      intervals.reserve(nrecs);
+      wakes.reserve(nrecs);
+      unsigned bit_changes[slf_user_in::COUNT];
+      memset(bit_changes, 0, sizeof bit_changes);
+
+      for (size_t idx = 0 ; idx < nrecs ; idx += 1) {
+	    if (idx > 0 && recs[idx].timestamp_ns >= recs[idx-1].timestamp_ns)
+		  intervals.push_back(recs[idx].timestamp_ns - recs[idx-1].timestamp_ns);
+	    wakes.push_back(recs[idx].wake_ns);
+
+	    uint32_t changed = recs[idx].user_in_old ^ recs[idx].user_in_new;
+	    for (unsigned bit = 0 ; bit < slf_user_in::COUNT ; bit += 1)
+		  if (changed & (1 << bit)) bit_changes[bit] += 1;
+      }
+
+      printf("%s: %zu events\n", path, nrecs);
+      if (nrecs > 1) {
+	    uint64_t span = recs[nrecs-1].timestamp_ns - recs[0].timestamp_ns;
+	    printf("%-16s: %.3f s\n", "span", span / 1e9);
+	    if (span > 0)
+		  printf("%-16s: %.3f\n", "events/sec", (nrecs - 1) / (span / 1e9));
+      }
+      for (unsigned bit = 0 ; bit < slf_user_in::COUNT ; bit += 1)
+	    printf("%-16s: %u changes\n", slf_user_in::name(bit), bit_changes[bit]);
+
+      print_percentiles("interval", intervals);
+      print_percentiles("wake latency", wakes);
+
+      munmap(map, st.st_size);
+      return 0;
+}
+
+int main(int argc, char*argv[])
+{
+      const char*dev_path = slf_device::default_path();
+      const char*out_path = 0;
+      const char*summary_path = 0;
+      unsigned seconds = 0;
+      size_t buffer_kb = 1024;
+
+      for (int arg_idx = 1 ; arg_idx < argc ; arg_idx += 1) {
+	    if (strncmp(argv[arg_idx],"--path=",7) == 0) {
+		  dev_path = argv[arg_idx]+7;
+
+	    } else if (strncmp(argv[arg_idx],"--output=",9) == 0) {
+		  out_path = argv[arg_idx]+9;
+
+	    } else if (strncmp(argv[arg_idx],"--summary=",10) == 0) {
+		  summary_path = argv[arg_idx]+10;
+
+	    } else if (strncmp(argv[arg_idx],"--seconds=",10) == 0) {
+		  seconds = strtoul(argv[arg_idx]+10,0,0);
+
+	    } else if (strncmp(argv[arg_idx],"--buffer-kb=",12) == 0) {
+		  buffer_kb = strtoul(argv[arg_idx]+12,0,0);
+
+	    } else {
+		  fprintf(stderr, "Unknown argument: %s\n", argv[arg_idx]);
+		  return 2;
+	    }
+      }
+
+      if (summary_path)
+	    return do_summary(summary_path);
+
+      if (out_path == 0) {
+	    fprintf(stderr, "usage: %s --output=<file> [--path=<dev>] [--seconds=<n>] [--buffer-kb=<n>]\n"
+		    "       %s --summary=<file>\n", argv[0], argv[0]);
+	    return 2;
+      }
+
+      return do_record(dev_path, out_path, seconds, buffer_kb);
+}
@@ -17,52 +17,63 @@
  *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
-# include  <slf_fpga.h>
+# include  "libslf.h"
+# include  <slf_fpga_regs.h>
 # include  <cstdio>
 # include  <cstdlib>
 # include  <cstring>
-# include  <sys/types.h>
-# include  <fcntl.h>
-# include  <unistd.h>
 
 int main(int argc, char*argv[])
 {
-      const char*dev_path = "/dev/slf_fpga0";
-      struct slf_fpga_leds_s setting;
-
-      setting.led_value = 0x00000000;
+      const char*dev_path = slf_device::default_path();
+      slf_leds setting;
+      bool use_mmap = false;
 
       for (int arg_idx = 1 ; arg_idx < argc ; arg_idx += 1) {
 	    if (strncmp(argv[arg_idx],"--path=",7) == 0) {
 		  dev_path = argv[arg_idx]+7;
 		  
 	    } else if (strncmp(argv[arg_idx],"--leds=",7) == 0) {
-		  setting.led_value = strtoul(argv[arg_idx]+7,0,0);
+		  setting = slf_leds(strtoul(argv[arg_idx]+7,0,0));
+
+	    } else if (strcmp(argv[arg_idx],"--mmap") == 0) {
+		  use_mmap = true;
 
 	    } else {
 	    }
       }
 
-      int dev = open(dev_path, O_RDWR, 0);
-      if (dev < 0) {
-	    fprintf(stderr, "%s: Unable to open device\n", dev_path);
+      slf_device dev (dev_path);
+      if (! dev.is_open()) {
+	    fprintf(stderr, "%s: Unable to open device: %s\n", dev_path, strerror(-dev.error()));
 	    return -1;
       }
 
-      int rc = ioctl(dev, SLF_FPGA_LEDS, &setting);
+      if (use_mmap) {
+	      // Write the LEDs register directly through the mapped
+	      // register window.
+	    slf_fpga_regs regs (dev.fd());
+	    if (! regs.is_mapped()) {
+		  fprintf(stderr, "%s: Unable to map device registers\n", dev_path);
+		  return -1;
+	    }
+	    regs.leds(setting.raw());
+      } else {
+	    dev.leds(setting);
+      }
 
-      struct slf_fpga_UserIn_s user_in;
-      rc = ioctl(dev, SLF_FPGA_UserIn, &user_in);
-      printf("PB0: %s\n", user_in.user_in_value&0x01? "PRESSED" : "");
-      printf("PB1: %s\n", user_in.user_in_value&0x02? "PRESSED" : "");
-      printf("PB2: %s\n", user_in.user_in_value&0x04? "PRESSED" : "");
-      printf("PB3: %s\n", user_in.user_in_value&0x08? "PRESSED" : "");
-      printf("DIP_SW0: %s\n", user_in.user_in_value&0x10? "ON" : "off");
-      printf("DIP_SW1: %s\n", user_in.user_in_value&0x20? "ON" : "off");
-      printf("DIP_SW2: %s\n", user_in.user_in_value&0x40? "ON" : "off");
-      printf("DIP_SW3: %s\n", user_in.user_in_value&0x80? "ON" : "off");
+      slf_user_in user_in;
+      int rc = dev.read_user_in(user_in);
+      if (rc < 0) {
+	    fprintf(stderr, "%s: Unable to read user inputs: %s\n", dev_path, strerror(-rc));
+	    return -1;
+      }
 
-      close(dev);
+      for (unsigned idx = 0 ; idx < slf_user_in::PB_COUNT ; idx += 1)
+	    printf("%s: %s\n", slf_user_in::name(idx), user_in.pb(idx)? "PRESSED" : "");
+      for (unsigned idx = 0 ; idx < slf_user_in::DIP_SW_COUNT ; idx += 1)
+	    printf("%s: %s\n", slf_user_in::name(slf_user_in::PB_COUNT+idx),
+		   user_in.dip_sw(idx)? "ON" : "off");
 
       return 0;
 }
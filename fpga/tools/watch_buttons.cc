@@ -17,46 +17,47 @@
  *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+# include  "libslf.h"
 # include  <cstdio>
-# include  <sys/types.h>
-# include  <fcntl.h>
-# include  <unistd.h>
-# include  <slf_fpga.h>
+# include  <cstring>
+# include  <poll.h>
+
+static void print_event(const slf_input_event&evt)
+{
+      uint32_t changes = evt.changed();
+      for (unsigned idx = 0 ; idx < slf_user_in::COUNT ; idx += 1) {
+	    if (changes & (1 << idx))
+		  printf("%-7s: %s\n", slf_user_in::name(idx), evt.new_value.bit(idx)? "ON" : "OFF");
+      }
+}
 
 int main(int argc, char*argv[])
 {
-      const char*dev_path = "/dev/slf_fpga0";
+      const char*dev_path = argc > 1? argv[1] : slf_device::default_path();
 
-      int dev = open(dev_path, O_RDWR, 0);
-      if (dev < 0) {
-	    fprintf(stderr, "%s: Unable to open device\n", dev_path);
+      slf_event_source events (dev_path);
+      if (! events.is_open()) {
+	    fprintf(stderr, "%s: Unable to open device: %s\n", dev_path, strerror(-events.error()));
 	    return -1;
       }
-      struct slf_fpga_wait_s status;
-      status.user_in_value = 0;
-      status.user_in_exp = 0;
-      status.timeout_ms = 500;
+
+	// The event source is readable when there are input change
+	// events. This is a simple event loop, but the fd can be
+	// mixed with other fds in the poll set.
+      struct pollfd fds[1];
+      fds[0].fd = events.fd();
+      fds[0].events = POLLIN;
 
       for (;;) {
-	    int rc = ioctl(dev, SLF_FPGA_WAIT, &status);
+	    int rc = poll(fds, 1, -1);
 	    if (rc < 0)
 		  break;
+	    if (! (fds[0].revents & POLLIN))
+		  continue;
 
-	    uint32_t changes = status.user_in_value ^ status.user_in_exp;
-
-	    if (changes == 0) printf("????? No changes?\n");
-	    if (changes&0x01) printf("PB0    : %s\n", status.user_in_value&0x01? "ON" : "OFF");
-	    if (changes&0x02) printf("PB1    : %s\n", status.user_in_value&0x02? "ON" : "OFF");
-	    if (changes&0x04) printf("PB2    : %s\n", status.user_in_value&0x04? "ON" : "OFF");
-	    if (changes&0x08) printf("PB3    : %s\n", status.user_in_value&0x08? "ON" : "OFF");
-	    if (changes&0x10) printf("DIP_SW0: %s\n", status.user_in_value&0x10? "ON" : "OFF");
-	    if (changes&0x20) printf("DIP_SW1: %s\n", status.user_in_value&0x20? "ON" : "OFF");
-	    if (changes&0x40) printf("DIP_SW2: %s\n", status.user_in_value&0x40? "ON" : "OFF");
-	    if (changes&0x80) printf("DIP_SW3: %s\n", status.user_in_value&0x80? "ON" : "OFF");
-
-	    status.user_in_exp = status.user_in_value;
+	    events.dispatch(print_event);
+	    fflush(stdout);
       }
 
-      close(dev);
       return 0;
 }
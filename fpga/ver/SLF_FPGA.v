@@ -21,7 +21,8 @@
  * This device connects to one of the GP AXI ports of the PS system in
  * the Zynq chip. The address width of that bus is 24bits, and we only
  * implement AXI4-Lite, so an AXI-Interconnect device is needed to match
- * it up with the actual processor.
+ * it up with the actual processor. The AXI4-Lite slave is pipelined, so
+ * it can complete a read and a write on every clock.
  * 
  * The design assumes the Zynq is installed on an Avnet MicroZed I/O
  * Carrier Card.
@@ -56,6 +57,61 @@
  *                                    [ 6] DIP_SW2
  *                                    [ 7] DIP_SW3
  *                                 [31: 8] <reserved>
+ *   24'h00_0014   [31: 0]  (rw) IrqModerate
+ *                                 [23: 0] Holdoff interval (clocks)
+ *                                 [31:24] Holdoff event count
+ *   24'h00_0018   [31: 0]  (ro) CycleCount (low word)
+ *   24'h00_001c   [31: 0]  (rw) FifoStatus
+ *                                 [ 8: 0] Level (ro)
+ *                                 [29: 9] <reserved>
+ *                                 [30]    Flush (write 1 to empty the FIFO)
+ *                                 [31]    Overflow (write 1 to clear)
+ *   24'h00_0020   [31: 0]  (ro) FifoPop
+ *                                 [ 7: 0] UserIn
+ *                                 [31: 8] CycleCount[23:0]
+ *   24'h00_0024   [31: 0]  (ro) CycleCountHi
+ *   24'h00_0028   [31: 0]  (ro) IrqStamp (low word)
+ *   24'h00_002c   [31: 0]  (ro) IrqStampHi
+ *   24'h00_0030   [31: 0]  (rw) SeqControl
+ *                                    [ 0] Run
+ *                                    [ 1] Loop
+ *                                 [15: 2] <reserved>
+ *                                 [31:16] Current frame (ro)
+ *   24'h00_0034   [31: 0]  (rw) SeqPeriod (clocks per frame, minus 1)
+ *   24'h00_0038   [31: 0]  (rw) SeqLength
+ *                                 [ 8: 0] Number of frames (1-256)
+ *   24'h00_003c   [31: 0]  (rw) PwmControl
+ *                                    [ 0] Wide (LEDsWide drive the LEDs)
+ *                                    [ 1] Gamma
+ *   24'h00_0040   [31: 0]  (rw) LEDsWide0
+ *                                 [ 7: 0] LED0
+ *                                 [15: 8] LED1
+ *                                 [23:16] LED2
+ *                                 [31:24] LED3
+ *   24'h00_0044   [31: 0]  (rw) LEDsWide1
+ *                                 [ 7: 0] LED4
+ *                                 [15: 8] LED5
+ *                                 [23:16] LED6
+ *                                 [31:24] LED7
+ *   24'h00_0048   [31: 0]  (rw) DebounceControl
+ *                                 [ 7: 0] Filter (ticks)
+ *                                 [23:16] Fast (one bit per UserIn)
+ *   24'h00_004c   [31: 0]  (ro) DebounceTick (clocks per tick)
+ *   24'h00_0050   [31: 0]  (rw) InterruptStatus
+ *                                 [ 7: 0] Changed (write 1 to clear)
+ *                                 [15: 8] UserIn (ro)
+ *                                 [24:16] FIFO Level (ro)
+ *                                 [30:25] <reserved>
+ *                                    [31] FIFO Overflow (ro)
+ *   24'h00_0054   [31: 0]  (rw) InterruptEdge
+ *                                 [ 7: 0] Rising edge enables
+ *                                 [15: 8] Falling edge enables
+ *                                 [30:16] <reserved>
+ *                                    [31] Latched
+ *   24'h00_0058   [31: 0]  (ro) CycleCountPeek (low word, no latch)
+ *   24'h00_005c   [31: 0]  (ro) IrqStampPeek (low word, no latch)
+ *   24'h00_0400 -
+ *   24'h00_07fc   [31: 0]  (wo) SeqFrames[0:255]
  *
  * Each user input can generate an interrupt if the corresponding bit
  * in the UserInIEN register is enabled. And interrupt is generated
@@ -64,13 +120,82 @@
  * button value differs from the expected value, an interrupt is
  * generated. So interrupts can be cleared by writing the value of
  * UserIn into UserInExpect.
+ *
+ * If the Latched bit of InterruptEdge is set, the interrupt comes
+ * from the InterruptStatus register instead. Each UserIn edge that is
+ * enabled in InterruptEdge sets the Changed flag for that input, and
+ * the flag stays set until software writes a 1 to it. An interrupt is
+ * generated when (Changed & UserInIEN) is not zero. An input that
+ * changes and changes back before software looks still leaves its
+ * flag set. The status also has the current UserIn and the state of
+ * the change FIFO, so an interrupt handler needs one read to see what
+ * happened and one write to acknowledge it.
+ *
+ * The IrqModerate register limits the interrupt rate. After an
+ * interrupt is cleared, the next interrupt is held off until either
+ * the holdoff interval has passed, or the holdoff event count of
+ * (enabled) input changes have happened, whichever comes first. An
+ * event count of 0 disables the count limit, and an interval of 0
+ * disables moderation entirely, which is the reset state.
+ *
+ * CycleCount is a free-running 64-bit count of AXI_S_ACLK clocks. It
+ * is read as two words. Reading the low word latches the high word into
+ * CycleCountHi, so read the low word first to get a consistent value.
+ * IrqStamp is the value of CycleCount at the moment the INTERRUPT
+ * output was last asserted, and is read the same way. Software can
+ * compare it with CycleCount to measure the interrupt latency. There
+ * is only one high word latch for each counter, so the interrupt
+ * handler reads the low words through CycleCountPeek and IrqStampPeek
+ * instead, which do not touch the latches. That way it cannot tear
+ * the 64-bit read of a user of the mapped registers. Every time
+ * the debounced UserIn changes, the new value and the low 24 bits of
+ * CycleCount are pushed into the change FIFO, so software can recover
+ * the exact order of changes, no matter how long it takes to get
+ * around to reading them. The timestamps wrap every 2^24 clocks, so
+ * the timing can only be recovered for entries younger than that.
+ * Reading FifoPop returns the oldest entry and removes it from the
+ * FIFO. FifoStatus gives the number of entries in the FIFO. If a
+ * change happens while the FIFO is full, the change is lost and the
+ * Overflow flag is set. Writing the Flush bit of FifoStatus discards
+ * all the entries at once.
+ *
+ * The user inputs are debounced before they reach UserIn. An input
+ * must be stable for Filter ticks of DebounceTick clocks before the
+ * change is accepted. If the Fast bit for an input is set, the first
+ * edge is accepted at once, and then the input is ignored until it
+ * has been stable for Filter ticks. The reset value of Filter comes
+ * from the DEBOUNCE_FILTER parameter.
+ *
+ * The LEDs are pulse width modulated with 256 steps, all sharing a
+ * single timebase. The LEDs register gives each LED 16 levels, which
+ * are expanded to 8 bits, so 15 is full on. If the Wide bit of
+ * PwmControl is set, the LEDsWide registers give 8-bit levels
+ * instead. If the Gamma bit is set, the levels go through a gamma
+ * correction table so that brightness steps look even.
+ *
+ * The LED sequencer plays frames from the SeqFrames memory to the LEDs,
+ * so that software doesn't have to update the LEDs register for every
+ * step of an animation. Each frame has the same format as the LEDs
+ * register. Setting Run starts the sequence at frame 0, and each frame
+ * is shown for SeqPeriod+1 clocks. After the last frame (SeqLength-1)
+ * the sequence starts over if Loop is set, otherwise the Run bit
+ * clears itself. While Run is set the sequencer drives the LEDs, and
+ * otherwise the LEDs register does. The SeqFrames memory is block RAM,
+ * and is write-only; reads of it return 0.
  */
 `default_nettype none
 `timescale 1ps/1ps
 
 module SLF_FPGA
   #(parameter addr_width = 24,
-    parameter BURST_LEN_ORDER = 4
+    parameter BURST_LEN_ORDER = 4,
+    // Clocks that a user input must be stable to be accepted. This
+    // is the reset value of the DebounceControl filter, which can be
+    // changed at run time. The default suits real buttons, but a
+    // simulation may want less.
+    parameter DEBOUNCE_FILTER = 100000,
+    // Clocks per step of the 256 step LED pulse width modulation.
+    parameter PWM_CLOCK_DIVIDER = 3125
     /* */)
    (// AXI4 port connected to a GP port. This is a slave port, with
     // the processor the master.
@@ -131,6 +256,32 @@ module SLF_FPGA
    localparam [addr_width-1:0] ADDRESS_UserIn   = 'h00_0008;
    localparam [addr_width-1:0] ADDRESS_UserInExp= 'h00_000c;
    localparam [addr_width-1:0] ADDRESS_UserInIEN= 'h00_0010;
+   localparam [addr_width-1:0] ADDRESS_IrqModerate='h00_0014;
+   localparam [addr_width-1:0] ADDRESS_CycleCount= 'h00_0018;
+   localparam [addr_width-1:0] ADDRESS_FifoStatus= 'h00_001c;
+   localparam [addr_width-1:0] ADDRESS_FifoPop  = 'h00_0020;
+   localparam [addr_width-1:0] ADDRESS_CycleCountHi='h00_0024;
+   localparam [addr_width-1:0] ADDRESS_IrqStamp = 'h00_0028;
+   localparam [addr_width-1:0] ADDRESS_IrqStampHi='h00_002c;
+   localparam [addr_width-1:0] ADDRESS_SeqControl='h00_0030;
+   localparam [addr_width-1:0] ADDRESS_SeqPeriod= 'h00_0034;
+   localparam [addr_width-1:0] ADDRESS_SeqLength= 'h00_0038;
+   localparam [addr_width-1:0] ADDRESS_PwmControl='h00_003c;
+   localparam [addr_width-1:0] ADDRESS_LEDsWide0= 'h00_0040;
+   localparam [addr_width-1:0] ADDRESS_LEDsWide1= 'h00_0044;
+   localparam [addr_width-1:0] ADDRESS_DebounceControl='h00_0048;
+   localparam [addr_width-1:0] ADDRESS_DebounceTick='h00_004c;
+   localparam [addr_width-1:0] ADDRESS_InterruptStatus='h00_0050;
+   localparam [addr_width-1:0] ADDRESS_InterruptEdge='h00_0054;
+   localparam [addr_width-1:0] ADDRESS_CycleCountPeek='h00_0058;
+   localparam [addr_width-1:0] ADDRESS_IrqStampPeek='h00_005c;
+   localparam [addr_width-1:0] ADDRESS_SeqFrames= 'h00_0400;
+
+   // The change FIFO has 2**CHANGE_FIFO_ORDER entries.
+   localparam CHANGE_FIFO_ORDER = 8;
+
+   // The sequencer has 2**SEQ_FRAME_ORDER frames.
+   localparam SEQ_FRAME_ORDER = 8;
 
    // Make an active-high version of the reset signal. The reset goes
    // to so much stuff, that we want it buffered. We might as well make
@@ -138,23 +289,74 @@ module SLF_FPGA
    reg 				reset_int;
    always @(posedge AXI_S_ACLK) reset_int <= ~AXI_ARESETn;
 
-   // Receive the write address.
-   reg [addr_width-1:0] write_address;
+   // The write cycle involves 3 channels: the write address, the
+   // write data, and the write response. The address and data may
+   // arrive in either order, or together. Each has a holding register
+   // that takes the address or data if it arrives before the other.
+   // The write happens as soon as both are available, and there is
+   // room for the response, so if AW and W arrive together and BREADY
+   // is held high, there is a write on every clock. To wit:
+   //
+   //    AWVALID: - + + + - - -
+   //    WVALID : - + + + - - -
+   //    write  : - + + + - - -
+   //    BVALID : - - + + + - -
+   //
+   reg 			write_address_full;
+   reg [addr_width-1:0] write_address_hold;
+   reg 			write_data_full;
+   reg [31:0] 		write_data_hold;
+   reg 			reg_s_bvalid;
+   assign AXI_S_AWREADY = ~write_address_full;
+   assign AXI_S_WREADY  = ~write_data_full;
+   assign AXI_S_BVALID  = reg_s_bvalid;
+   assign AXI_S_BRESP   = 2'b00;
+
+   wire write_address_avail = write_address_full | AXI_S_AWVALID;
+   wire write_data_avail    = write_data_full    | AXI_S_WVALID;
+   wire write_response_free = ~reg_s_bvalid | AXI_S_BREADY;
+
+   // This is true for the clock where the write is actually done. The
+   // register write logic uses this, along with the write_address and
+   // write_data, to update the addressed register.
+   wire write_enable = write_address_avail & write_data_avail & write_response_free;
+   wire [addr_width-1:0] write_address = write_address_full? write_address_hold : AXI_S_AWADDR;
+   wire [31:0] write_data = write_data_full? write_data_hold : AXI_S_WDATA;
+
    always @(posedge AXI_S_ACLK)
      if (reset_int) begin
-	write_address <= 0;
-     end else if (AXI_S_AWREADY & AXI_S_AWVALID) begin
-	write_address <= AXI_S_AWADDR;
+	write_address_full <= 1'b0;
+	write_data_full    <= 1'b0;
+	reg_s_bvalid       <= 1'b0;
+
+     end else begin
+	// Hold the address if it arrives but the write can't happen yet.
+	if (write_enable)
+	  write_address_full <= 1'b0;
+	else if (AXI_S_AWREADY & AXI_S_AWVALID)
+	  write_address_full <= 1'b1;
+
+	// Hold the data if it arrives but the write can't happen yet.
+	if (write_enable)
+	  write_data_full <= 1'b0;
+	else if (AXI_S_WREADY & AXI_S_WVALID)
+	  write_data_full <= 1'b1;
+
+	// Every write gets a response. A new response can replace the
+	// response that the master is taking in this clock.
+	if (write_enable)
+	  reg_s_bvalid <= 1'b1;
+	else if (AXI_S_BREADY)
+	  reg_s_bvalid <= 1'b0;
      end
 
-   // Receive the read address
-   reg [addr_width-1:0] read_address;
    always @(posedge AXI_S_ACLK)
-     if (reset_int) begin
-	read_address <= 0;
-     end else if (AXI_S_ARREADY & AXI_S_ARVALID) begin
-	read_address <= AXI_S_ARADDR;
-     end
+     if (AXI_S_AWREADY & AXI_S_AWVALID)
+       write_address_hold <= AXI_S_AWADDR;
+
+   always @(posedge AXI_S_ACLK)
+     if (AXI_S_WREADY & AXI_S_WVALID)
+       write_data_hold <= AXI_S_WDATA;
 
    // The build id of the device. This module, and the output patterns
    // it emits, is generated at compile time.
@@ -166,6 +368,24 @@ module SLF_FPGA
    reg [31:0]  LEDs_register;
    wire        LEDs_register_hit_w = (write_address == ADDRESS_LEDs);
 
+   // The 8-bit LED levels, and the PWM control that selects them.
+   reg [1:0]   PwmControl_register;
+   wire        PwmControl_register_hit_w = (write_address == ADDRESS_PwmControl);
+   reg [31:0]  LEDsWide0_register;
+   wire        LEDsWide0_register_hit_w = (write_address == ADDRESS_LEDsWide0);
+   reg [31:0]  LEDsWide1_register;
+   wire        LEDsWide1_register_hit_w = (write_address == ADDRESS_LEDsWide1);
+
+   // The debounce engine counts in ticks of DEBOUNCE_TICK clocks,
+   // chosen so that DEBOUNCE_FILTER is about 64 ticks.
+   localparam DEBOUNCE_TICK = DEBOUNCE_FILTER >= 64? DEBOUNCE_FILTER / 64 : 1;
+   localparam [7:0] DEBOUNCE_FILTER_TICKS = (DEBOUNCE_FILTER + DEBOUNCE_TICK - 1) / DEBOUNCE_TICK;
+
+   // The debounce filter length (in ticks) and the fast inputs.
+   reg [7:0]   DebounceControl_filter;
+   reg [7:0]   DebounceControl_fast;
+   wire        DebounceControl_register_hit_w = (write_address == ADDRESS_DebounceControl);
+
    // This is the Read-only register that reads the switches.
    wire [31:0] UserIn_register;
 
@@ -175,166 +395,306 @@ module SLF_FPGA
    reg [31:0]  UserInIEN_register;
    wire        UserInIEN_register_hit_w = (write_address == ADDRESS_UserInIEN);
 
-   // This state machine drives the read process. Wait for a read
-   // address. When we get the read address, mark the read as ready,
-   // holding off the next address. When the read completes, then
-   // be ready for the next address. To wit:
+   reg [31:0]  IrqModerate_register;
+   wire        IrqModerate_register_hit_w = (write_address == ADDRESS_IrqModerate);
+
+   // The latched interrupt status, and the edges that set it.
+   wire [31:0] InterruptStatus_register;
+   wire        InterruptStatus_register_hit_w = (write_address == ADDRESS_InterruptStatus);
+   reg [31:0]  InterruptEdge_register;
+   wire        InterruptEdge_register_hit_w = (write_address == ADDRESS_InterruptEdge);
+
+   // Free-running clock counter, and its value when the interrupt was
+   // last asserted. The high words are latched when the low words are
+   // read, so that the 64-bit values can be read without tearing.
+   reg [63:0]  CycleCount_register;
+   reg [31:0]  CycleCountHi_register;
+   reg [63:0]  IrqStamp_register;
+   reg [31:0]  IrqStampHi_register;
+
+   // The LED sequencer registers, and the frame memory window. The
+   // frame memory is selected by the address bits above the word
+   // index.
+   reg [1:0]   SeqControl_register;
+   wire        SeqControl_register_hit_w = (write_address == ADDRESS_SeqControl);
+   reg [31:0]  SeqPeriod_register;
+   wire        SeqPeriod_register_hit_w = (write_address == ADDRESS_SeqPeriod);
+   reg [SEQ_FRAME_ORDER:0] SeqLength_register;
+   wire        SeqLength_register_hit_w = (write_address == ADDRESS_SeqLength);
+   wire        SeqFrames_hit_w = (write_address[addr_width-1:SEQ_FRAME_ORDER+2]
+				  == ADDRESS_SeqFrames[addr_width-1:SEQ_FRAME_ORDER+2]);
+   reg [SEQ_FRAME_ORDER-1:0] seq_index;
+
+   // Level and overflow of the change FIFO. The overflow bit is write
+   // one to clear, and writing a one to the flush bit empties the FIFO.
+   wire [31:0] FifoStatus_register;
+   wire        FifoStatus_register_hit_w = (write_address == ADDRESS_FifoStatus);
+
+   // The head of the change FIFO. Reading this pops the FIFO.
+   wire [31:0] FifoPop_register;
+
+   // The read process decodes the read address as it arrives, and
+   // clocks the read data directly into the read data register. The
+   // read address is accepted whenever the read data register is free,
+   // or being read by the master in this clock, so if RREADY is held
+   // high there is a read on every clock. To wit:
    //
-   //    ARREADY: + + + - - - +
-   //    ARVALID: - - + _ . . .
-   //    RREADY : . . . . - + -
-   //    RVALID : - - - - + + -
+   //    ARREADY: + + + + + - +
+   //    ARVALID: - + + + - - -
+   //    RREADY : . . + + - + .
+   //    RVALID : - - + + + + -
    //
-   reg 	      reg_s_arready;
    reg 	      reg_s_rvalid;
    reg [31:0] reg_s_rdata;
-   assign     AXI_S_ARREADY = reg_s_arready;
+   assign     AXI_S_ARREADY = ~reg_s_rvalid | AXI_S_RREADY;
    assign     AXI_S_RVALID  = reg_s_rvalid;
    assign     AXI_S_RDATA   = reg_s_rdata;
    assign     AXI_S_RRESP   = 2'b00;
 
-   // Deliver the addressed read register contents to the read data
-   // buffer, ready for a read cycle. It is safe and efficient to just
-   // track the read address, because the state machine will assure
-   // that only one read is in progress, and will only flag the data
-   // as valid if it really is valid.
+   wire       read_enable = AXI_S_ARREADY & AXI_S_ARVALID;
+
+   // Capture the addressed register only when the read address is
+   // accepted, so that the data holds still while the master reads
+   // it. That matters for FifoPop, which changes when read.
+   always @(posedge AXI_S_ACLK)
+     if (read_enable)
+       case (AXI_S_ARADDR)
+	 ADDRESS_BUILD_ID : reg_s_rdata <= build_id;
+	 ADDRESS_LEDs     : reg_s_rdata <= LEDs_register;
+	 ADDRESS_UserIn   : reg_s_rdata <= UserIn_register;
+	 ADDRESS_UserInExp: reg_s_rdata <= UserInExp_register;
+	 ADDRESS_UserInIEN: reg_s_rdata <= UserInIEN_register;
+	 ADDRESS_IrqModerate: reg_s_rdata <= IrqModerate_register;
+	 ADDRESS_CycleCount: reg_s_rdata <= CycleCount_register[31:0];
+	 ADDRESS_CycleCountHi: reg_s_rdata <= CycleCountHi_register;
+	 ADDRESS_IrqStamp : reg_s_rdata <= IrqStamp_register[31:0];
+	 ADDRESS_IrqStampHi: reg_s_rdata <= IrqStampHi_register;
+	 ADDRESS_CycleCountPeek: reg_s_rdata <= CycleCount_register[31:0];
+	 ADDRESS_IrqStampPeek: reg_s_rdata <= IrqStamp_register[31:0];
+	 ADDRESS_SeqControl: reg_s_rdata <= {{(16-SEQ_FRAME_ORDER){1'b0}}, seq_index,
+					     14'd0, SeqControl_register};
+	 ADDRESS_SeqPeriod: reg_s_rdata <= SeqPeriod_register;
+	 ADDRESS_SeqLength: reg_s_rdata <= {{(31-SEQ_FRAME_ORDER){1'b0}}, SeqLength_register};
+	 ADDRESS_PwmControl: reg_s_rdata <= {30'd0, PwmControl_register};
+	 ADDRESS_LEDsWide0: reg_s_rdata <= LEDsWide0_register;
+	 ADDRESS_LEDsWide1: reg_s_rdata <= LEDsWide1_register;
+	 ADDRESS_DebounceControl: reg_s_rdata <= {8'd0, DebounceControl_fast,
+						  8'd0, DebounceControl_filter};
+	 ADDRESS_DebounceTick: reg_s_rdata <= DEBOUNCE_TICK;
+	 ADDRESS_InterruptStatus: reg_s_rdata <= InterruptStatus_register;
+	 ADDRESS_InterruptEdge: reg_s_rdata <= InterruptEdge_register;
+	 ADDRESS_FifoStatus: reg_s_rdata <= FifoStatus_register;
+	 ADDRESS_FifoPop  : reg_s_rdata <= FifoPop_register;
+	 default          : reg_s_rdata <= 32'd0;
+       endcase
+
+   // The FIFO pops when the read data is captured.
+   wire       FifoPop_register_hit_r = read_enable && (AXI_S_ARADDR == ADDRESS_FifoPop);
+
+   // Reading the low words latches the high words.
    always @(posedge AXI_S_ACLK)
-     case (read_address)
-       ADDRESS_BUILD_ID : reg_s_rdata <= build_id;
-       ADDRESS_LEDs     : reg_s_rdata <= LEDs_register;
-       ADDRESS_UserIn   : reg_s_rdata <= UserIn_register;
-       ADDRESS_UserInExp: reg_s_rdata <= UserInExp_register;
-       ADDRESS_UserInIEN: reg_s_rdata <= UserInIEN_register;
-       default          : reg_s_rdata <= 32'd0;
-     endcase
+     if (read_enable && AXI_S_ARADDR == ADDRESS_CycleCount)
+       CycleCountHi_register <= CycleCount_register[63:32];
 
-   reg 	      read_address_ready_del;
+   always @(posedge AXI_S_ACLK)
+     if (read_enable && AXI_S_ARADDR == ADDRESS_IrqStamp)
+       IrqStampHi_register <= IrqStamp_register[63:32];
 
    always @(posedge AXI_S_ACLK)
      if (reset_int) begin
-	reg_s_arready <= 1'b1;
-	reg_s_rvalid  <= 1'b0;
-	read_address_ready_del <= 1'b0;
-
-     end else if (AXI_S_ARREADY && AXI_S_ARVALID) begin
-	// If a read address arrives, then switch to the read step. Put
-	// in a delay to give a chance for the read address to collect
-	// the read data.
-	reg_s_arready <= 1'b0;
-	read_address_ready_del <= 1'b1;
-
-     end else if (read_address_ready_del) begin
-	// The read address was delivered, and the correct data was clocked
-	// into the read_data register. Now set it up to be read by the
-	// processor.
-	read_address_ready_del <= 1'b0;
+	reg_s_rvalid <= 1'b0;
+     end else if (read_enable) begin
 	reg_s_rvalid <= 1'b1;
-
-     end else if (AXI_S_RREADY && AXI_S_RVALID) begin
-	// The processor accepts the read response, so now we can go back
-	// to waiting for the next read address.
-	reg_s_rvalid  <= 1'b0;
-	reg_s_arready <= 1'b1;
-
-     end else begin
-	// Waiting for something to happen.
+     end else if (AXI_S_RREADY) begin
+	reg_s_rvalid <= 1'b0;
      end
 
-   // The write cycle involves 3 channels: the write address, the
-   // write data, and the write response. The state machine flows
-   // the state by waiting for the address channel, then the write
-   // data channel, and then sending a response.
-   reg 			       reg_s_awready;
-   reg 			       reg_s_wready;
-   reg 			       reg_s_bvalid;
-   assign AXI_S_AWREADY = reg_s_awready;
-   assign AXI_S_WREADY  = reg_s_wready;
-   assign AXI_S_BVALID  = reg_s_bvalid;
-   assign AXI_S_BRESP   = 2'b00;
+   // Detect and process writes to the LEDs register.
    always @(posedge AXI_S_ACLK)
      if (reset_int) begin
-	reg_s_awready <= 1'b1;
-	reg_s_wready  <= 1'b0;
-	reg_s_bvalid  <= 1'b0;
-
-     end else if (AXI_S_AWREADY & AXI_S_AWVALID) begin
-	// An address has been sent. Get ready to receive data.
-	reg_s_awready <= 1'b0;
-	reg_s_wready  <= 1'b1;
-
-     end else if (AXI_S_WREADY & AXI_S_WVALID) begin
-	// Data has been sent. Now send the response.
-	reg_s_wready  <= 1'b0;
-	reg_s_bvalid  <= 1'b1;
-
-     end else if (AXI_S_BREADY & AXI_S_BVALID) begin
-	// Sender has received the response. Go back to
-	// waiting for an address.
-	reg_s_awready <= 1'b1;
-	reg_s_wready  <= 1'b0;
-	reg_s_bvalid  <= 1'b0;
+	LEDs_register <= 32'h00000000;
+     end else if (LEDs_register_hit_w & write_enable) begin
+	LEDs_register <= write_data;
+     end
 
+   // Detect and process writes to the wide LEDs registers and the
+   // PWM control.
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	PwmControl_register <= 2'b00;
+	LEDsWide0_register  <= 32'h00000000;
+	LEDsWide1_register  <= 32'h00000000;
      end else begin
+	if (PwmControl_register_hit_w & write_enable)
+	  PwmControl_register <= write_data[1:0];
+	if (LEDsWide0_register_hit_w & write_enable)
+	  LEDsWide0_register <= write_data;
+	if (LEDsWide1_register_hit_w & write_enable)
+	  LEDsWide1_register <= write_data;
      end
 
-   // Detect and process writes to the LEDs register.
+   // Detect and process writes to the DebounceControl register.
    always @(posedge AXI_S_ACLK)
      if (reset_int) begin
-	LEDs_register <= 32'h00000000;
-     end else if (LEDs_register_hit_w & AXI_S_WREADY & AXI_S_WVALID) begin
-	LEDs_register <= AXI_S_WDATA;
+	DebounceControl_filter <= DEBOUNCE_FILTER_TICKS;
+	DebounceControl_fast   <= 8'h00;
+     end else if (DebounceControl_register_hit_w & write_enable) begin
+	DebounceControl_filter <= write_data[7:0];
+	DebounceControl_fast   <= write_data[23:16];
      end
 
    // Detect and process writes to the UserInExp register.
    always @(posedge AXI_S_ACLK)
      if (reset_int) begin
 	UserInExp_register <= 32'h00000000;
-     end else if (UserInExp_register_hit_w & AXI_S_WREADY & AXI_S_WVALID) begin
-	UserInExp_register <= AXI_S_WDATA;
+     end else if (UserInExp_register_hit_w & write_enable) begin
+	UserInExp_register <= write_data;
      end
 
    // Detect and process writes to the UserInIEN register.
    always @(posedge AXI_S_ACLK)
      if (reset_int) begin
 	UserInIEN_register <= 32'h00000000;
-     end else if (UserInIEN_register_hit_w & AXI_S_WREADY & AXI_S_WVALID) begin
-	UserInIEN_register <= AXI_S_WDATA;
+     end else if (UserInIEN_register_hit_w & write_enable) begin
+	UserInIEN_register <= write_data;
      end
 
-   pulse_width led0_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[ 3: 0]), .PULSE(LED0));
-   pulse_width led1_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[ 7: 4]), .PULSE(LED1));
-   pulse_width led2_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[11: 8]), .PULSE(LED2));
-   pulse_width led3_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[15:12]), .PULSE(LED3));
-   pulse_width led4_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[19:16]), .PULSE(LED4));
-   pulse_width led5_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[23:20]), .PULSE(LED5));
-   pulse_width led6_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[27:24]), .PULSE(LED6));
-   pulse_width led7_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.WIDTH(LEDs_register[31:28]), .PULSE(LED7));
-
-   debounce pb0_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-		    .SIGNAL_IN(PB0), .SIGNAL_OUT(UserIn_register[0]));
-   debounce pb1_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-		    .SIGNAL_IN(PB1), .SIGNAL_OUT(UserIn_register[1]));
-   debounce pb2_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-		    .SIGNAL_IN(PB2), .SIGNAL_OUT(UserIn_register[2]));
-   debounce pb3_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-		    .SIGNAL_IN(PB3), .SIGNAL_OUT(UserIn_register[3]));
-
-   debounce dip_sw0_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.SIGNAL_IN(DIP_SW0), .SIGNAL_OUT(UserIn_register[4]));
-   debounce dip_sw1_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.SIGNAL_IN(DIP_SW1), .SIGNAL_OUT(UserIn_register[5]));
-   debounce dip_sw2_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.SIGNAL_IN(DIP_SW2), .SIGNAL_OUT(UserIn_register[6]));
-   debounce dip_sw3_mod(.CLOCK(AXI_S_ACLK), .RESET(reset_int),
-			.SIGNAL_IN(DIP_SW3), .SIGNAL_OUT(UserIn_register[7]));
+   // Detect and process writes to the InterruptEdge register. The
+   // reset value enables both edges of all the inputs, but leaves
+   // the interrupt in the UserInExp compare mode.
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	InterruptEdge_register <= 32'h0000ffff;
+     end else if (InterruptEdge_register_hit_w & write_enable) begin
+	InterruptEdge_register <= write_data & 32'h8000ffff;
+     end
+
+   // Detect and process writes to the IrqModerate register.
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	IrqModerate_register <= 32'h00000000;
+     end else if (IrqModerate_register_hit_w & write_enable) begin
+	IrqModerate_register <= write_data;
+     end
+
+   // The LED sequencer. The frame memory is written through the
+   // register interface and read by the sequencer, so that it maps to
+   // a simple dual-port block RAM.
+   reg [31:0]  seq_mem [0:(1<<SEQ_FRAME_ORDER)-1];
+   reg [31:0]  seq_frame;
+   reg [31:0]  seq_timer;
+
+   wire        seq_run  = SeqControl_register[0];
+   wire        seq_loop = SeqControl_register[1];
+   wire        seq_tick = seq_timer == 32'd0;
+   wire        seq_last = {1'b0, seq_index} == SeqLength_register - 1;
+   wire        seq_done = seq_run & seq_tick & seq_last & ~seq_loop;
+
+   always @(posedge AXI_S_ACLK)
+     if (SeqFrames_hit_w & write_enable)
+       seq_mem[write_address[SEQ_FRAME_ORDER+1:2]] <= write_data;
+
+   always @(posedge AXI_S_ACLK)
+     seq_frame <= seq_mem[seq_index];
+
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	SeqControl_register <= 2'b00;
+	SeqPeriod_register  <= 32'd0;
+	SeqLength_register  <= 1;
+     end else begin
+	if (SeqControl_register_hit_w & write_enable)
+	  SeqControl_register <= write_data[1:0];
+	else if (seq_done)
+	  SeqControl_register[0] <= 1'b0;
+
+	if (SeqPeriod_register_hit_w & write_enable)
+	  SeqPeriod_register <= write_data;
+
+	if (SeqLength_register_hit_w & write_enable)
+	  SeqLength_register <= write_data[SEQ_FRAME_ORDER:0];
+     end
+
+   always @(posedge AXI_S_ACLK)
+     if (reset_int || !seq_run) begin
+	seq_index <= 0;
+	seq_timer <= SeqPeriod_register;
+     end else if (seq_tick) begin
+	seq_timer <= SeqPeriod_register;
+	if (! seq_last)
+	  seq_index <= seq_index + 1;
+	else if (seq_loop)
+	  seq_index <= 0;
+     end else begin
+	seq_timer <= seq_timer - 1;
+     end
+
+   // Expand a 4-bit per LED value (the LEDs register format) to
+   // 8-bit levels, so that 15 is full on.
+   function [63:0] leds_narrow_to_wide(input [31:0] narrow);
+      integer idx;
+      for (idx = 0 ; idx < 8 ; idx = idx + 1)
+	leds_narrow_to_wide[8*idx +: 8] = {narrow[4*idx +: 4], narrow[4*idx +: 4]};
+   endfunction
+
+   // The sequencer drives the LEDs while it is running. Otherwise,
+   // the PwmControl Wide bit selects the LEDsWide registers or the
+   // LEDs register.
+   wire [63:0] led_levels_linear = seq_run? leds_narrow_to_wide(seq_frame)
+	       : PwmControl_register[0]? {LEDsWide1_register, LEDsWide0_register}
+	       : leds_narrow_to_wide(LEDs_register);
+
+   // Apply the gamma correction. There is a single gamma table, shared
+   // by all the LEDs in turn, one LED per clock. The table output is
+   // registered, so the level and channel are delayed to match.
+   reg [2:0]   pwm_chan;
+   reg [2:0]   pwm_chan_d;
+   reg [7:0]   pwm_linear_d;
+   reg [7:0]   led_level [0:7];
+   wire [7:0]  pwm_linear = led_levels_linear[8*pwm_chan +: 8];
+   wire [7:0]  pwm_gamma;
+   gamma_rom gamma_mod(.CLOCK(AXI_S_ACLK), .ADDR(pwm_linear), .DATA(pwm_gamma));
+
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	pwm_chan   <= 3'd0;
+	pwm_chan_d <= 3'd0;
+     end else begin
+	pwm_chan     <= pwm_chan + 1;
+	pwm_chan_d   <= pwm_chan;
+	pwm_linear_d <= pwm_linear;
+	led_level[pwm_chan_d] <= PwmControl_register[1]? pwm_gamma : pwm_linear_d;
+     end
+
+   // All the LED channels share one PWM timebase, and each channel
+   // only compares its level to the shared phase.
+   wire [7:0]  pwm_phase;
+   pwm_timebase #(.CLOCK_DIVIDER(PWM_CLOCK_DIVIDER)) pwm_timebase_mod
+     (.CLOCK(AXI_S_ACLK), .RESET(reset_int), .PHASE(pwm_phase));
+
+   wire [7:0]  led_pulse;
+   genvar      led_idx;
+   generate for (led_idx = 0 ; led_idx < 8 ; led_idx = led_idx + 1) begin : led_gen
+      pulse_width led_mod
+	(.CLOCK(AXI_S_ACLK), .RESET(reset_int), .PHASE(pwm_phase),
+	 .WIDTH(led_level[led_idx]), .PULSE(led_pulse[led_idx]));
+   end endgenerate
+
+   assign LED0 = led_pulse[0];
+   assign LED1 = led_pulse[1];
+   assign LED2 = led_pulse[2];
+   assign LED3 = led_pulse[3];
+   assign LED4 = led_pulse[4];
+   assign LED5 = led_pulse[5];
+   assign LED6 = led_pulse[6];
+   assign LED7 = led_pulse[7];
+
+   // All the user inputs share one debounce engine.
+   debounce #(.WIDTH(8), .TICK_CLOCKS(DEBOUNCE_TICK)) user_in_mod
+     (.CLOCK(AXI_S_ACLK), .RESET(reset_int),
+      .FILTER(DebounceControl_filter), .FAST(DebounceControl_fast),
+      .SIGNAL_IN({DIP_SW3, DIP_SW2, DIP_SW1, DIP_SW0, PB3, PB2, PB1, PB0}),
+      .SIGNAL_OUT(UserIn_register[7:0]));
 
    assign UserIn_register[31:8] = 24'h0000_00;
 
@@ -343,8 +703,145 @@ module SLF_FPGA
    // device is enabled.) 
    wire [31:0] UserIn_interrupt = (UserIn_register ^ UserInExp_register) & UserInIEN_register;
 
+   always @(posedge AXI_S_ACLK)
+     if (reset_int)
+       CycleCount_register <= 64'd0;
+     else
+       CycleCount_register <= CycleCount_register + 1;
+
+   // Keep the previous UserIn value, to detect changes.
+   reg [31:0]  UserIn_prev;
+   always @(posedge AXI_S_ACLK)
+     UserIn_prev <= UserIn_register;
+
+   // The latched interrupt status. A change flag is set by a UserIn
+   // edge that InterruptEdge enables, and stays set until software
+   // writes a 1 to it. If an edge and the clear land on the same
+   // clock, the edge wins, so no edge is lost.
+   wire [7:0]  UserIn_rise = UserIn_register[7:0] & ~UserIn_prev[7:0];
+   wire [7:0]  UserIn_fall = ~UserIn_register[7:0] & UserIn_prev[7:0];
+   wire [7:0]  UserIn_edges = (UserIn_rise & InterruptEdge_register[7:0])
+	       | (UserIn_fall & InterruptEdge_register[15:8]);
+   wire [7:0]  InterruptStatus_clear = (InterruptStatus_register_hit_w & write_enable)? write_data[7:0] : 8'h00;
+
+   reg [7:0]   InterruptStatus_changed;
+   always @(posedge AXI_S_ACLK)
+     if (reset_int)
+       InterruptStatus_changed <= 8'h00;
+     else
+       InterruptStatus_changed <= (InterruptStatus_changed & ~InterruptStatus_clear) | UserIn_edges;
+
+   // The change FIFO. Push the new UserIn value with a timestamp
+   // whenever the debounced inputs change. The memory is written and
+   // read synchronously, so that it can be implemented in block RAM.
+   // The wr/rd pointers have an extra bit so that a full FIFO can be
+   // distinguished from an empty one. The head register reads ahead
+   // when the FIFO pops, and bypasses the memory when the entry is
+   // being written in the same clock, so that it is always valid in
+   // the next clock and FifoPop can be read on every clock.
+   reg [31:0]  change_fifo_mem [0:(1<<CHANGE_FIFO_ORDER)-1];
+   reg [CHANGE_FIFO_ORDER:0] change_fifo_wr;
+   reg [CHANGE_FIFO_ORDER:0] change_fifo_rd;
+   reg [31:0]  change_fifo_head;
+   reg 	       change_fifo_overflow;
+
+   wire [CHANGE_FIFO_ORDER:0] change_fifo_level = change_fifo_wr - change_fifo_rd;
+   wire        change_fifo_empty = change_fifo_level == 0;
+   wire        change_fifo_full  = change_fifo_level[CHANGE_FIFO_ORDER];
+   wire        change_fifo_push  = UserIn_register[7:0] != UserIn_prev[7:0];
+   wire        change_fifo_pop   = FifoPop_register_hit_r & ~change_fifo_empty;
+
+   wire [31:0] change_fifo_entry = {CycleCount_register[23:0], UserIn_register[7:0]};
+   wire        change_fifo_write = change_fifo_push & ~change_fifo_full;
+   wire        change_fifo_flush = FifoStatus_register_hit_w & write_enable & write_data[30];
+   wire [CHANGE_FIFO_ORDER:0] change_fifo_rd_next = change_fifo_flush? change_fifo_wr
+	       : change_fifo_pop? change_fifo_rd + 1 : change_fifo_rd;
+
+   always @(posedge AXI_S_ACLK)
+     if (change_fifo_write)
+       change_fifo_mem[change_fifo_wr[CHANGE_FIFO_ORDER-1:0]] <= change_fifo_entry;
+
+   always @(posedge AXI_S_ACLK)
+     if (change_fifo_write && change_fifo_wr == change_fifo_rd_next)
+       change_fifo_head <= change_fifo_entry;
+     else
+       change_fifo_head <= change_fifo_mem[change_fifo_rd_next[CHANGE_FIFO_ORDER-1:0]];
+
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	change_fifo_wr <= 0;
+	change_fifo_rd <= 0;
+	change_fifo_overflow <= 1'b0;
+
+     end else begin
+	if (change_fifo_write)
+	  change_fifo_wr <= change_fifo_wr + 1;
+	change_fifo_rd <= change_fifo_rd_next;
+
+	if (change_fifo_push & change_fifo_full)
+	  change_fifo_overflow <= 1'b1;
+	else if (FifoStatus_register_hit_w & write_enable & write_data[31])
+	  change_fifo_overflow <= 1'b0;
+     end
+
+   assign FifoStatus_register = {change_fifo_overflow, {(31-CHANGE_FIFO_ORDER-1){1'b0}}, change_fifo_level};
+   assign FifoPop_register = change_fifo_empty? 32'd0 : change_fifo_head;
+
+   // The status also carries the current inputs and the FIFO state, so
+   // that an interrupt handler can get all it needs in a single read.
+   assign InterruptStatus_register = {change_fifo_overflow, {(14-CHANGE_FIFO_ORDER){1'b0}},
+				      change_fifo_level, UserIn_register[7:0],
+				      InterruptStatus_changed};
+
+   // Interrupt moderation. While the interrupt is asserted, keep the
+   // holdoff counter loaded, so that it starts counting down when the
+   // interrupt is cleared. Also count the enabled input changes that
+   // happen during the holdoff.
+   wire [23:0] irq_holdoff_interval = IrqModerate_register[23:0];
+   wire [7:0]  irq_holdoff_events   = IrqModerate_register[31:24];
+
+   wire        UserIn_changed = |((UserIn_register ^ UserIn_prev) & UserInIEN_register);
+
+   reg [23:0]  irq_holdoff_count;
+   reg [7:0]   irq_event_count;
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	irq_holdoff_count <= 24'd0;
+	irq_event_count   <= 8'd0;
+
+     end else if (INTERRUPT) begin
+	irq_holdoff_count <= irq_holdoff_interval;
+	irq_event_count   <= 8'd0;
+
+     end else begin
+	if (irq_holdoff_count != 24'd0)
+	  irq_holdoff_count <= irq_holdoff_count - 1;
+	if (UserIn_changed && irq_event_count != 8'hff)
+	  irq_event_count <= irq_event_count + 1;
+     end
+
+   wire irq_holdoff_done = (irq_holdoff_count == 24'd0)
+	|| (irq_holdoff_events != 8'd0 && irq_event_count >= irq_holdoff_events);
+
    // Combine all the interrupt sources, to generate a single
-   // interrupt output.
-   assign INTERRUPT = |UserIn_interrupt;
+   // interrupt output. The Latched bit of InterruptEdge selects the
+   // latched change flags instead of the UserInExp compare. The
+   // moderation holds it off.
+   wire        irq_source = InterruptEdge_register[31]
+	       ? |(InterruptStatus_changed & UserInIEN_register[7:0])
+	       : |UserIn_interrupt;
+   assign INTERRUPT = irq_source & irq_holdoff_done;
+
+   // Stamp the clock count when the interrupt is asserted.
+   reg 	       INTERRUPT_prev;
+   always @(posedge AXI_S_ACLK)
+     if (reset_int) begin
+	INTERRUPT_prev <= 1'b0;
+	IrqStamp_register <= 64'd0;
+     end else begin
+	INTERRUPT_prev <= INTERRUPT;
+	if (INTERRUPT & ~INTERRUPT_prev)
+	  IrqStamp_register <= CycleCount_register;
+     end
 
 endmodule // SLF_FPGA
@@ -20,40 +20,96 @@
 `default_nettype none
 `timescale 1ps/1ps
 
+/*
+ * This is a debounce engine for a group of WIDTH inputs. Instead of
+ * a wide counter per input, there is one tick generator shared by all
+ * the inputs, and each input only needs a small counter of ticks.
+ *
+ * FILTER is the number of ticks that an input must be stable before
+ * the change is passed to the output. Because the first tick can come
+ * at any time after the change, the input is actually stable for
+ * between FILTER and FILTER+1 ticks.
+ *
+ * The inputs with their FAST bit set instead pass the first edge to
+ * the output right away, then lock out further changes until the
+ * input has been stable for FILTER ticks. This suits push buttons,
+ * where the first edge is a real press or release. It does not filter
+ * out glitches, so the slower mode is better for noisy inputs.
+ */
 module debounce
-  #(parameter bounce_filter = 100000
+  #(parameter WIDTH = 8,
+    // Clocks per filter tick.
+    parameter TICK_CLOCKS = 1024
     /* */)
    (input wire CLOCK,
     input wire RESET,
-    input wire SIGNAL_IN,
-    output reg SIGNAL_OUT
+    input wire [7:0] FILTER,
+    input wire [WIDTH-1:0] FAST,
+    input wire [WIDTH-1:0] SIGNAL_IN,
+    output wire [WIDTH-1:0] SIGNAL_OUT
     /* */);
 
-   // This just buffers the input signal, so that it is at least clean,
-   // if not free of pulses.
-   reg 	       signal_in2;
+   // This is the shared tick generator. The tick is a single clock
+   // pulse every TICK_CLOCKS clocks.
+   localparam TICK_BITS = $clog2(TICK_CLOCKS);
+   reg [TICK_BITS:0] tick_counter;
+   wire 	     tick = tick_counter[TICK_BITS];
    always @(posedge CLOCK)
-     signal_in2 <= SIGNAL_IN;
+     if (RESET || tick)
+       tick_counter <= TICK_CLOCKS - 2;
+     else
+       tick_counter <= tick_counter - 1;
 
-   // Now filter out pulses. The input needs to be stable for at least
-   // bounce_filter clocks before we let the input propagate to the output.
-   localparam BOUNCE_FILTER_BITS = $clog2(bounce_filter);
-   reg [BOUNCE_FILTER_BITS : 0] filter;
+   // Synchronize the inputs to the clock. The inputs are asynchronous,
+   // so take two stages to be safe from metastability. The third stage
+   // is the previous value, to detect changes while locked out.
+   reg [WIDTH-1:0] signal_in1;
+   reg [WIDTH-1:0] signal_in2;
+   reg [WIDTH-1:0] signal_in3;
+   always @(posedge CLOCK) begin
+      signal_in1 <= SIGNAL_IN;
+      signal_in2 <= signal_in1;
+      signal_in3 <= signal_in2;
+   end
 
-   always @(posedge CLOCK)
-     if (RESET) begin
-	SIGNAL_OUT <= 1'b0;
-	filter     <= bounce_filter;
+   genvar idx;
+   generate for (idx = 0 ; idx < WIDTH ; idx = idx + 1) begin : filter_gen
+      reg [7:0] count;
+      reg 	locked;
+      reg 	out;
+      assign SIGNAL_OUT[idx] = out;
+
+      always @(posedge CLOCK)
+	if (RESET) begin
+	   out    <= 1'b0;
+	   count  <= 8'd0;
+	   locked <= 1'b0;
+
+	end else if (locked) begin
+	   // Locked out after a fast edge. Wait for the input to
+	   // settle for FILTER ticks, whatever its value.
+	   if (signal_in2[idx] != signal_in3[idx])
+	     count <= 8'd0;
+	   else if (tick && count >= FILTER)
+	     locked <= 1'b0;
+	   else if (tick)
+	     count <= count + 1;
+
+	end else if (signal_in2[idx] == out) begin
+	   count <= 8'd0;
 
-     end else if (signal_in2 == SIGNAL_OUT) begin
-	filter     <= bounce_filter;
+	end else if (FAST[idx]) begin
+	   out    <= signal_in2[idx];
+	   count  <= 8'd0;
+	   locked <= 1'b1;
 
-     end else if (filter[BOUNCE_FILTER_BITS]) begin
-	SIGNAL_OUT <= signal_in2;
-	filter     <= bounce_filter;
+	end else if (tick && count >= FILTER) begin
+	   out    <= signal_in2[idx];
+	   count  <= 8'd0;
 
-     end else begin
-	filter     <= filter - 1;
-     end
+	end else if (tick) begin
+	   count <= count + 1;
+	end
+   end endgenerate
 
 endmodule // debounce
@@ -20,42 +20,25 @@
 `default_nettype none
 `timescale 1ps/1ps
 
+/*
+ * Generate a pulse that is WIDTH/256 of the period set by the shared
+ * pwm_timebase. A WIDTH of 255 is full on.
+ */
 module pulse_width
-  #(parameter CLOCK_DIVIDER = 50000
-    /* */)
    (input wire  CLOCK,
     input wire 	RESET,
+    // Position within the pulse period, from the pwm_timebase
+    input wire [7:0] PHASE,
     // Width of the pulse
-    input wire [3:0] WIDTH,
+    input wire [7:0] WIDTH,
     // The generated pulse
     output reg 	PULSE
     /* */);
 
-   // The clock_counter divides down the system clock to a pulse
-   // clock that is much lower frequency, so that we don't have
-   // high-frequency signals leaving the chip. The clock_phase
-   // counter then counts out the phase position within the pulse
-   // width of the generated signal.
-   localparam             CLOCK_DIV_BITS = $clog2(CLOCK_DIVIDER);
-   reg [CLOCK_DIV_BITS:0] clock_counter;
-   reg [3:0] 		  clock_phase;
-   always @(posedge CLOCK)
-     if (RESET) begin
-	clock_counter <= CLOCK_DIVIDER - 1;
-	clock_phase   <= 1'b0;
-
-     end else if (clock_counter[CLOCK_DIV_BITS]) begin
-	clock_phase   <= clock_phase + 1;
-	clock_counter <= CLOCK_DIVIDER - 1;
-
-     end else begin
-	clock_counter <= clock_counter - 1;
-     end
-
    always @(posedge CLOCK)
-     if (clock_phase < WIDTH)
-       PULSE <= 1'b1;
-     else
+     if (RESET)
        PULSE <= 1'b0;
+     else
+       PULSE <= (WIDTH == 8'hff) || (PHASE < WIDTH);
 
 endmodule // pulse_width
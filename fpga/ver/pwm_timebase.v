@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+`default_nettype none
+`timescale 1ps/1ps
+
+/*
+ * This is the shared timebase for the pulse_width channels. The
+ * clock_counter divides down the system clock to a pulse clock that
+ * is much lower frequency, so that we don't have high-frequency
+ * signals leaving the chip. The PHASE counter then counts out the
+ * position within the 256 step pulse period. All the channels share
+ * this, so each channel only needs a comparator.
+ */
+module pwm_timebase
+  #(parameter CLOCK_DIVIDER = 3125
+    /* */)
+   (input wire  CLOCK,
+    input wire 	RESET,
+    // Position within the pulse period
+    output reg [7:0] PHASE
+    /* */);
+
+   localparam             CLOCK_DIV_BITS = $clog2(CLOCK_DIVIDER);
+   reg [CLOCK_DIV_BITS:0] clock_counter;
+   always @(posedge CLOCK)
+     if (RESET) begin
+	clock_counter <= CLOCK_DIVIDER - 1;
+	PHASE         <= 8'd0;
+
+     end else if (clock_counter[CLOCK_DIV_BITS]) begin
+	PHASE         <= PHASE + 1;
+	clock_counter <= CLOCK_DIVIDER - 1;
+
+     end else begin
+	clock_counter <= clock_counter - 1;
+     end
+
+endmodule // pwm_timebase
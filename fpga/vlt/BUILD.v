@@ -0,0 +1,7 @@
+`timescale 1ps/1ps
+`default_nettype none
+// This stands in for the BUILD module that ../ver/BUILD.sh generates,
+// so that the Verilator model has a fixed build id.
+module BUILD (output wire [31:0] build_id);
+   assign build_id = 32'd0;
+endmodule
@@ -0,0 +1,192 @@
+#ifndef __slf_vlt_axi_H
+#define __slf_vlt_axi_H
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is an AXI4-Lite master that drives the Verilator model of the
+ * SLF_FPGA directly. It implements the slf_bus interface, so the test
+ * scenarios from ../sim run against it just as they do against the
+ * simbus simulation, but in-process and without any IPC.
+ *
+ * The model is clocked only while a transaction or wait is in
+ * progress. Inputs are changed while the clock is low, and the model
+ * is evaluated before the rising edge, so that the ready/valid
+ * signals that the slave drives are settled when the handshake is
+ * checked.
+ */
+# include  "slf_bus.h"
+# include  "VSLF_FPGA.h"
+
+class slf_vlt_axi : public slf_bus {
+
+    public:
+      explicit slf_vlt_axi(VSLF_FPGA*top)
+      : top_(top), clocks_(0), force_delay_(0), force_next_(0)
+      {
+	    top_->AXI_S_ACLK    = 0;
+	    top_->AXI_ARESETn   = 1;
+	    top_->AXI_S_AWVALID = 0;
+	    top_->AXI_S_AWADDR  = 0;
+	    top_->AXI_S_AWPROT  = 0;
+	    top_->AXI_S_WVALID  = 0;
+	    top_->AXI_S_WDATA   = 0;
+	    top_->AXI_S_WSTRB   = 0xf;
+	    top_->AXI_S_BREADY  = 0;
+	    top_->AXI_S_ARVALID = 0;
+	    top_->AXI_S_ARADDR  = 0;
+	    top_->AXI_S_ARPROT  = 0;
+	    top_->AXI_S_RREADY  = 0;
+	    user_in(0);
+	    top_->eval();
+      }
+
+	// Hold the reset asserted for some clocks.
+      void reset(unsigned clocks)
+      {
+	    top_->AXI_ARESETn = 0;
+	    for (unsigned idx = 0 ; idx < clocks ; idx += 1)
+		  tick();
+	    top_->AXI_ARESETn = 1;
+	    tick();
+      }
+
+	// Drive the push buttons (bits 3:0) and DIP switches (bits 7:4).
+      void user_in(uint32_t val)
+      {
+	    top_->PB0     = (val >> 0) & 1;
+	    top_->PB1     = (val >> 1) & 1;
+	    top_->PB2     = (val >> 2) & 1;
+	    top_->PB3     = (val >> 3) & 1;
+	    top_->DIP_SW0 = (val >> 4) & 1;
+	    top_->DIP_SW1 = (val >> 5) & 1;
+	    top_->DIP_SW2 = (val >> 6) & 1;
+	    top_->DIP_SW3 = (val >> 7) & 1;
+      }
+
+	// Total clocks since the model was created.
+      uint64_t clocks() const { return clocks_; }
+
+      uint32_t read32(uint64_t addr)
+      {
+	    top_->AXI_S_ARADDR  = addr;
+	    top_->AXI_S_ARVALID = 1;
+	    top_->AXI_S_RREADY  = 1;
+	    for (;;) {
+		  top_->eval();
+		  bool done = top_->AXI_S_ARREADY;
+		  tick();
+		  if (done) break;
+	    }
+	    top_->AXI_S_ARVALID = 0;
+
+	    uint32_t val;
+	    for (;;) {
+		  top_->eval();
+		  bool done = top_->AXI_S_RVALID;
+		  val = top_->AXI_S_RDATA;
+		  tick();
+		  if (done) break;
+	    }
+	    top_->AXI_S_RREADY = 0;
+	    return val;
+      }
+
+      void write32(uint64_t addr, uint32_t data)
+      {
+	    top_->AXI_S_AWADDR  = addr;
+	    top_->AXI_S_AWVALID = 1;
+	    top_->AXI_S_WDATA   = data;
+	    top_->AXI_S_WVALID  = 1;
+	    top_->AXI_S_BREADY  = 1;
+	    while (top_->AXI_S_AWVALID || top_->AXI_S_WVALID) {
+		  top_->eval();
+		  bool aw_done = top_->AXI_S_AWVALID && top_->AXI_S_AWREADY;
+		  bool w_done  = top_->AXI_S_WVALID  && top_->AXI_S_WREADY;
+		  tick();
+		  if (aw_done) top_->AXI_S_AWVALID = 0;
+		  if (w_done)  top_->AXI_S_WVALID  = 0;
+	    }
+
+	      // There is no test bench around the model, so do what
+	      // SLF_SIM does with the forced inputs here, from the
+	      // clock of the write. Without the button_stim, the
+	      // released inputs are all 0.
+	    if (addr == SIM_UserInForce) {
+		  force_next_ = (data & 0x80000000)? data & 0xff : 0;
+		  force_delay_ = (data >> 16) & 0xff;
+		  if (force_delay_ == 0)
+			user_in(force_next_);
+	    }
+
+	    for (;;) {
+		  top_->eval();
+		  bool done = top_->AXI_S_BVALID;
+		  tick();
+		  if (done) break;
+	    }
+	    top_->AXI_S_BREADY = 0;
+      }
+
+      void wait(unsigned clocks, uint32_t*irq_mask)
+      {
+	    for (unsigned idx = 0 ; idx < clocks ; idx += 1) {
+		  tick();
+		  if (irq_mask && (*irq_mask & irq()))
+			break;
+	    }
+	    if (irq_mask)
+		  *irq_mask = irq();
+      }
+
+    private:
+      uint32_t irq()
+      {
+	    top_->eval();
+	    return top_->INTERRUPT? 1 : 0;
+      }
+
+      void tick()
+      {
+	    top_->AXI_S_ACLK = 1;
+	    top_->eval();
+	    top_->AXI_S_ACLK = 0;
+	    top_->eval();
+	    clocks_ += 1;
+
+	    if (force_delay_ > 0) {
+		  force_delay_ -= 1;
+		  if (force_delay_ == 0)
+			user_in(force_next_);
+	    }
+      }
+
+    private:
+      VSLF_FPGA*top_;
+      uint64_t clocks_;
+	// A SIM_UserInForce value that is held off for some clocks.
+      unsigned force_delay_;
+      uint32_t force_next_;
+
+    private: // not implemented
+      slf_vlt_axi(const slf_vlt_axi&);
+      slf_vlt_axi& operator= (const slf_vlt_axi&);
+};
+
+#endif
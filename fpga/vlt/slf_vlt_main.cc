@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This runs the SLF_FPGA test scenarios against a Verilator model of
+ * the device, in-process. The options are the same as for slf_master
+ * in ../sim, except that there is no simbus port, and:
+ *
+ *   --repeat=<N>  Run the scenario list N times, for soak testing
+ *
+ * At the end, the simulation rate is written to stderr.
+ */
+
+# define _STDC_FORMAT_MACROS
+# include  "slf_vlt_axi.h"
+# include  "slf_scenarios.h"
+# include  "verilated.h"
+# include  <chrono>
+# include  <cinttypes>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+
+/*
+ * Older versions of Verilator want this.
+ */
+double sc_time_stamp()
+{
+      return 0;
+}
+
+int main(int argc, char*argv[])
+{
+      const char*scenarios = "all";
+      const char*csv_path = 0;
+      unsigned count = 256;
+      unsigned repeat = 1;
+      double clock_ns = 6.666;
+
+      Verilated::commandArgs(argc, argv);
+
+      for (int arg_idx = 1 ; arg_idx < argc ; arg_idx += 1) {
+	    if (strncmp(argv[arg_idx],"--scenario=",11) == 0) {
+		  scenarios = argv[arg_idx]+11;
+
+	    } else if (strncmp(argv[arg_idx],"--count=",8) == 0) {
+		  count = strtoul(argv[arg_idx]+8,0,0);
+
+	    } else if (strncmp(argv[arg_idx],"--repeat=",9) == 0) {
+		  repeat = strtoul(argv[arg_idx]+9,0,0);
+
+	    } else if (strncmp(argv[arg_idx],"--clock-ns=",11) == 0) {
+		  clock_ns = strtod(argv[arg_idx]+11,0);
+
+	    } else if (strncmp(argv[arg_idx],"--csv=",6) == 0) {
+		  csv_path = argv[arg_idx]+6;
+
+	    } else if (argv[arg_idx][0] == '+') {
+		    // Plusargs are for the model.
+
+	    } else {
+		  fprintf(stderr, "Unknown argument: %s\n", argv[arg_idx]);
+		  return 2;
+	    }
+      }
+
+      FILE*csv = stdout;
+      if (csv_path) {
+	    csv = fopen(csv_path, "w");
+	    if (csv == 0) {
+		  fprintf(stderr, "%s: Unable to open CSV file\n", csv_path);
+		  return 2;
+	    }
+      }
+
+      VSLF_FPGA*top = new VSLF_FPGA;
+      slf_vlt_axi bus (top);
+      bus.reset(8);
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      int fail_count = 0;
+      for (unsigned idx = 0 ; idx < repeat ; idx += 1) {
+	    int rc = slf_scenarios_run(bus, scenarios, count, clock_ns, csv);
+	    if (rc < 0) {
+		  fail_count = -1;
+		  break;
+	    }
+	    fail_count += rc;
+      }
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      fprintf(stderr, "%" PRIu64 " clocks in %.3f s: %.3f Mclocks/s\n",
+	      bus.clocks(), elapsed.count(),
+	      elapsed.count() > 0.0? bus.clocks() / elapsed.count() / 1e6 : 0.0);
+
+      top->final();
+      delete top;
+
+      if (csv != stdout)
+	    fclose(csv);
+
+      if (fail_count < 0)
+	    return 2;
+      return fail_count == 0? 0 : 1;
+}